@@ -7,23 +7,60 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
+#include <memory>
 
 #include "ngslib/bam_header.h"
 #include "ngslib/bam_record.h"
+#include "ngslib/index_cache.h"
+#include "ngslib/index_stats.h"
+#include "ngslib/prefetch_reader.h"
+#include "ngslib/read_filter.h"
+#include "ngslib/record_batch.h"
+#include "ngslib/column_batch.h"
+#include "ngslib/record_iterator.h"
+#include "ngslib/region.h"
+#include "ngslib/thread_pool.h"
 
 namespace ngslib {
 
+    class MultiBam;
+
     // A Bam file I/O class
     class Bam {
     private:
         std::string _fname;  // input file name
         std::string _mode;   // Mode matching / [rwa][bcefFguxz0-9]* /
         int _io_status;      // I/O status code in read() and next() function
+        int _fields;         // The fields of records to decode, see Fields.
+        ReadFilter _filter;  // Records failing it are skipped in read().
 
         samFile *_fp;        // samFile file pointer, samFile is as the same as htsFile in sam.h
         BamHeader _hdr;      // The sam/bam/cram header.
         hts_idx_t *_idx;     // BAM or CRAM index pointer.
+        SharedIndex _shared_idx;  // Hold _idx if it comes from IndexCache (BAI/CSI).
         hts_itr_t *_itr;     // A SAM/BAM/CRAM iterator for a specify region
+
+        // Read records ahead in a background thread if it's not NULL.
+        std::unique_ptr<PrefetchReader> _prefetch;
+
+        // Stop the producer of prefetching before _fp is changed by `func`,
+        // throw an invalid_argument if it would drop records read ahead.
+        void _stop_prefetch(const char *func);
+
+        // The record reused by begin()/end() iteration.
+        BamRecord _iter_br;
+
+        // Region strings of a multi-region iterator, kept alive with _itr.
+        std::vector<std::string> _itr_regions;
+
+        // Create a multi-region iterator for the sorted and merged regions.
+        bool _fetch_regions(const std::vector<GenomeRegion> &regions);
+
+        // Thread pool for BGZF (de)compression or CRAM (de)coding. It could be
+        // owned by this object or shared with other files, and will be released
+        // after the last file using it has been closed.
+        SharedThreadPool _tpool;
         // call `hts_open` function to open file.
         /*!
           @abstract       Open a sequence data (SAM/BAM/CRAM) or variant data (VCF/BCF)
@@ -59,16 +96,53 @@ namespace ngslib {
         */
         void _open(const std::string fn, const std::string mode);
 
+        // Close the file opened by _open() if a constructor fails after it.
+        void _close_on_error() {
+            sam_close(_fp);
+            _fp = NULL;
+        }
+
+        // MultiBam closes and resumes a file by its _fp and _itr.
+        friend class MultiBam;
+
         Bam(const Bam &b) = delete;             // reject using copy constructor (C++11 style).
         Bam &operator=(const Bam &b) = delete;  // reject using copy/assignment operator (C++11 style).
 
     public:
-        Bam() : _fp(NULL), _itr(NULL), _idx(NULL), _io_status(-1) {}
+        Bam() : _fp(NULL), _itr(NULL), _idx(NULL), _io_status(-1), _fields(Fields::ALL) {}
 
-        Bam(const std::string &fn, const std::string mode = "r") : _fp(NULL), _itr(NULL), _idx(NULL),
-                                                                   _io_status(-1) {
+        /** Open a SAM/BAM/CRAM file.
+         *
+         * @param fn        The file name
+         * @param mode      Mode matching / [rwa][bcefFguxz0-9]* /
+         * @param nthreads  Create a private pool with `nthreads` threads for
+         *                  (de)compression if > 0. Default: 0, no extra thread.
+         */
+        Bam(const std::string &fn, const std::string mode = "r", int nthreads = 0) : _fp(NULL), _itr(NULL),
+                                                                                     _idx(NULL), _io_status(-1),
+                                                                                     _fields(Fields::ALL) {
             // @mode matching: [rwa]
             _open(fn, mode);
+            try {
+                if (nthreads > 0) set_threads(nthreads);
+            } catch (...) {
+                _close_on_error();  // ~Bam() is not called for a half-built object.
+                throw;
+            }
+        }
+
+        // Open a SAM/BAM/CRAM file and attach a thread pool which may be shared
+        // with other files.
+        Bam(const std::string &fn, const std::string mode, const SharedThreadPool &tp) : _fp(NULL), _itr(NULL),
+                                                                                         _idx(NULL), _io_status(-1),
+                                                                                         _fields(Fields::ALL) {
+            _open(fn, mode);
+            try {
+                set_thread_pool(tp);
+            } catch (...) {
+                _close_on_error();
+                throw;
+            }
         }
 
         ~Bam();
@@ -78,25 +152,117 @@ namespace ngslib {
 
         hts_idx_t *idx();
 
+        // Return the index shared with other objects, load it if necessary.
+        // NULL for CRAM, whose index is bound to this file handle.
+        SharedIndex shared_idx();
+
         BamHeader &header();
 
-        /// Generate and save an index file
-        /** @param fn        Input BAM/etc filename, to which .csi/etc will be added
+        /** Create a private thread pool with `nthreads` threads and attach it to
+         *  this file. Call it before reading or writing any record.
+         *
+         * @exception Throws an invalid_argument if fail to create or attach the pool.
+         */
+        void set_threads(int nthreads);
+
+        /** Attach a (shared) thread pool to this file. The pool is released
+         *  automatically after all the files using it have been closed. Only one
+         *  pool could be attached to a file.
+         *
+         * @exception Throws an invalid_argument if fail to attach the pool.
+         */
+        void set_thread_pool(const SharedThreadPool &tp);
+
+        // Return the thread pool attached to this file, NULL if no pool.
+        SharedThreadPool thread_pool() const { return _tpool; }
+
+        /** Read ahead up to `depth` records in a background thread, so that
+         *  decompression and I/O overlap with the work on records. Records are
+         *  returned by read() in the same order and with the same io_status().
+         *  fetch() can be called at any time, the records read ahead are dropped.
+         *
+         *  The producer uses the file, so set_prefetch(), set_fields() and
+         *  set_filter() are refused while records are being read ahead: call
+         *  them before reading, after fetch() or at the end of stream.
+         *
+         * @param depth  The max number of records read ahead, 0 to turn it off.
+         * @exception Throws an invalid_argument in the middle of reading ahead.
+         */
+        void set_prefetch(size_t depth);
+
+        /** Declare the fields of records going to be used, e.g.
+         *  `bam.set_fields(Fields::POS | Fields::FLAG | Fields::CIGAR)` for
+         *  coverage. Call it before reading any record.
+         *
+         *  For CRAM, only these fields are decoded (CRAM_OPT_REQUIRED_FIELDS),
+         *  and MD/NM are not generated unless AUX is required, which saves most
+         *  of the decoding time when sequence, qualities and tags are not used.
+         *  For SAM/BAM, all fields are decoded anyway.
+         *
+         *  In both cases, the accessors of BamRecord for the undeclared fields
+         *  throw an invalid_argument, so a missing field is found on BAM as
+         *  early as on CRAM. FLAG is always decoded as everything depends on it.
+         *
+         * @param fields  OR'ed values of Fields, Default: Fields::ALL.
+         * @exception Throws an invalid_argument if fail to set the CRAM options.
+         */
+        void set_fields(int fields);
+
+        // The fields of records to decode, see set_fields().
+        int fields() const { return _fields; }
+
+        /** Skip the records failing `filter` inside read(), before they become
+         *  a BamRecord, e.g. `bam.set_filter(ReadFilter(0, BAM_FDUP, 20))`.
+         *  It works with fetch(), read_batch(), range-for and prefetching. Call
+         *  it before reading, ReadFilter() to turn it off.
+         *
+         *  MAPQ is added to the fields of set_fields() if min_mapq > 0.
+         */
+        void set_filter(const ReadFilter &filter);
+
+        /** Skip the records by an htslib filter expression, e.g.
+         *  "mapq >= 20 && !flag.dup && rlen > 50" (see the "Filter expressions"
+         *  section of samtools(1)). It's evaluated by sam_read1() and
+         *  sam_itr_next() themselves, so is for BamIterator on this file too.
+         *  Make sure the fields it uses are declared by set_fields() for CRAM.
+         *
+         * @param expr  The expression, an empty one to turn it off.
+         * @exception Throws an invalid_argument if the expression is invalid.
+         */
+        void set_filter(const std::string &expr);
+
+        const ReadFilter &filter() const { return _filter; }
+
+        /// Generate and save an index file of this file, .bai/.csi/.crai is added
+        /** The file is read once more, use BamWriter::set_index() to index a
+            new file while writing it instead.
+
             @param min_shift Positive to generate CSI, or 0 to generate BAI
+            @param nthreads  The number of extra threads to decompress the file.
+                             Default: 0, no extra thread.
             @return  0 if successful, or negative if an error occurred (usually -1; or
                      -2: opening fn failed; -3: format not indexable; -4:
                      failed to create and/or save the index)
         */
-        int index_build(int min_shift = 0) {
-            return sam_index_build(_fname.c_str(), min_shift);
-        }
+        int index_build(int min_shift = 0, int nthreads = 0);
 
-        // load index of BAM or CRAM
+        // load index of BAM or CRAM. BAI/CSI is taken from the process-wide
+        // IndexCache, which is shared with other Bam objects of the same file.
         void index_load();
 
+        /** Read counts of every reference sequence, and the estimated compressed
+         *  bytes of its reads, from the index only (like `samtools idxstats`).
+         *  It takes milliseconds even for a huge BAM, as no read is scanned.
+         *  Counts and bytes are -1 for CRAM, whose index does not keep them.
+         *
+         * @exception Throws an invalid_argument if the index is not available.
+         */
+        IndexStats index_stats();
+
         /// Create a SAM/BAM/CRAM iterator pointer (hts_itr_t*) for one region.
         /** @param region  Region specification
-            @return 1 on success; 0 on failure
+            @return this Bam, which is true on success and could be iterated by
+                    range-for: `for (auto &r : bam.fetch("chr1:1-1000"))`
 
          Regions are parsed by hts_parse_reg(), and take one of the following forms:
 
@@ -113,9 +279,29 @@ namespace ngslib {
          The form `REF:` should be used when the reference name itself contains a colon.
          Note that SAM files must be bgzf-compressed for iterators to work.
         **/
-        bool fetch(const std::string &region);
+        Bam &fetch(const std::string &region);
+
+        Bam &fetch(const std::string &seq_id, hts_pos_t beg, hts_pos_t end);
+
+        /// Create one iterator for many regions (e.g. exome/panel targets).
+        /** @param regions    Region specifications, see fetch(region) above
+            @param merge_gap  Merge the regions on the same reference if the gap
+                              between them is <= merge_gap bp. Default: 0, only
+                              merge the overlapping and the bookended regions.
+                              Note that reads in the merged gaps are returned too.
+            @return this Bam, see fetch(region) above
+
+         Regions are sorted and coalesced first, and then passed to
+         sam_itr_regarray(), which merges the index chunks of all the regions
+         into one sorted list. So the file is read forward only once, and each
+         record overlapping several regions is returned exactly once.
+
+         @exception Throws an invalid_argument if any region is invalid.
+        **/
+        Bam &fetch(const std::vector<std::string> &regions, hts_pos_t merge_gap = 0);
 
-        bool fetch(const std::string &seq_id, hts_pos_t beg, hts_pos_t end);
+        /// Create one iterator for all the regions in a BED file, see above.
+        Bam &fetch_bed(const std::string &bed_fn, hts_pos_t merge_gap = 0);
 
         /// Read a record from a file
         /** @param fp   Pointer to the source file
@@ -127,6 +313,34 @@ namespace ngslib {
 
         int next(BamRecord &b) { return read(b); }
 
+        /** Read at most `n` records into a reusable batch.
+         *
+         *  The slots of `batch` are reused, so reading batch after batch into the
+         *  same RecordBatch does no malloc per record in the steady state.
+         *
+         *  @param batch  Records placeholder, will be cleared at first
+         *  @param n      The max number of records to read
+         *  @return the number of records in batch, 0 on end of stream or error.
+         *  Check io_status() for the status of the last read: -1 on end of stream,
+         *  < -1 on error.
+         **/
+        size_t read_batch(RecordBatch &batch, size_t n);
+
+        /** Read at most `n` records into a columnar batch, the same as above
+         *  but only the core fields (and the payload) of records are kept.
+         *  Decode less of CRAM by set_fields() if the payload is not needed.
+         **/
+        size_t read_batch(ColumnBatch &batch, size_t n);
+
+        typedef RecordInputIterator<Bam> iterator;
+
+        /** Input iterator over the records from the current position (or of the
+         *  fetched regions), the same as calling read() in a loop. It yields a
+         *  reference to a record reused by the whole iteration, no copy.
+         */
+        iterator begin() { return iterator(this, &_iter_br); }
+        iterator end() { return iterator(); }
+
         // For reading: >= 0 on successfully reading a new record,
         //              -1 on end of stream, < -1 on error;
         // For writing: >= 0 on successfully writing the record, -1 on error.
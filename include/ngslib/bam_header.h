@@ -59,13 +59,21 @@ namespace ngslib {
         // Create BamHeader from a exist header, rarely use.
         BamHeader(const sam_hdr_t *hdr) { _h = sam_hdr_dup(hdr); }
 
-        // Copy constructor.
-        BamHeader(const BamHeader &bh) { _h = sam_hdr_dup(bh._h); }
+        // Copy constructor, a deep copy by sam_hdr_dup().
+        BamHeader(const BamHeader &bh) { _h = bh._h ? sam_hdr_dup(bh._h) : NULL; }
+
+        // Move constructor and assignment, take over the header of `bh` and
+        // leave it empty.
+        BamHeader(BamHeader &&bh) noexcept : _h(bh._h) { bh._h = NULL; }
+        BamHeader &operator=(BamHeader &&bh) noexcept;
 
         BamHeader &operator=(const sam_hdr_t *hdr);
 
         BamHeader &operator=(const BamHeader &bh);
 
+        // An explicit deep copy.
+        BamHeader clone() const { return BamHeader(*this); }
+
         friend std::ostream &operator<<(std::ostream &os, const BamHeader &hd);
 
         void init() {
@@ -108,6 +116,10 @@ namespace ngslib {
         // Return a length of the reference sequences by the index of chromosome
         // in header.
         int64_t seq_length(int i) const { return _h->target_len[i]; }
+
+        // The same reference sequences (names and lengths, in the same order)
+        // as `bh`, so the target ids of the two headers are interchangeable.
+        bool same_sequences(const BamHeader &bh) const;
     };
 }
 
@@ -11,6 +11,11 @@
 #include <htslib/sam.h>
 #include "ngslib/bam.h"
 #include "ngslib/bam_record.h"
+#include "ngslib/index_cache.h"
+#include "ngslib/read_filter.h"
+#include "ngslib/record_batch.h"
+#include "ngslib/column_batch.h"
+#include "ngslib/record_iterator.h"
 
 namespace ngslib {
 
@@ -22,8 +27,12 @@ namespace ngslib {
 
         samFile *_fp;     // A pointer of SAM/BAM/CRAM
         hts_idx_t *_idx;  // Index
+        SharedIndex _shared_idx;  // Keep _idx alive if it's a shared index
         sam_hdr_t *_hdr;  // A pointer to the header of SAM/BAM/CRAM
 
+        BamRecord _iter_br;  // The record reused by begin()/end() iteration.
+        ReadFilter _filter;  // Records failing it are skipped in next().
+
     public:
 
         BamIterator() : _fp(NULL), _idx(NULL), _hdr(NULL), _itr(NULL) {}
@@ -51,6 +60,12 @@ namespace ngslib {
         explicit BamIterator(samFile *fp, hts_idx_t *idx, sam_hdr_t *hdr,
                              const std::string &region);
 
+        // Share the ownership of index (e.g. from Bam::shared_idx()), so the index
+        // is valid as long as this iterator is alive.
+        explicit BamIterator(samFile *fp, const SharedIndex &idx, sam_hdr_t *hdr);
+        explicit BamIterator(samFile *fp, const SharedIndex &idx, sam_hdr_t *hdr,
+                             const std::string &region);
+
         BamIterator(const BamIterator &bi);   // copy constructor
         BamIterator &operator=(const BamIterator &bi);
 
@@ -75,6 +90,18 @@ namespace ngslib {
          * */
         bool fetch(const std::string &region);
 
+        // Skip the records failing `filter` inside next(), see Bam::set_filter().
+        void set_filter(const ReadFilter &filter) { _filter = filter; }
+
+        /** Skip the records by an htslib filter expression. Note that it's set
+         *  on the file, which is shared with the Bam of this iterator.
+         *
+         * @exception Throws an invalid_argument if the expression is invalid.
+         */
+        void set_filter(const std::string &expr);
+
+        const ReadFilter &filter() const { return _filter; }
+
         /// Read a record from a file
         /** @param fp   Pointer to the source file
          *  @param h    Pointer to the header previously read (fully or partially)
@@ -84,6 +111,26 @@ namespace ngslib {
          **/
         int next(BamRecord &br);
 
+        /** Read at most `n` records into a reusable batch.
+         *
+         *  @param batch  Records placeholder, will be cleared at first
+         *  @param n      The max number of records to read
+         *  @param io_status  Set to the status of the last read: >= 0 if the
+         *                    batch is full, -1 on end of stream, < -1 on error
+         *  @return the number of records in batch.
+         **/
+        size_t read_batch(RecordBatch &batch, size_t n, int &io_status);
+
+        // Read at most `n` records into a columnar batch, see above.
+        size_t read_batch(ColumnBatch &batch, size_t n, int &io_status);
+
+        typedef RecordInputIterator<BamIterator> iterator;
+
+        // Input iterator over the records of the fetched region, the same as
+        // calling next() in a loop. It yields a reference to a reused record.
+        iterator begin() { return iterator(this, &_iter_br); }
+        iterator end() { return iterator(); }
+
         void destroy();
     };
 }
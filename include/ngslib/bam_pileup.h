@@ -0,0 +1,179 @@
+// The C++ codes for pileup of BAM/CRAM files
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_BAM_PILEUP_H__
+#define __INCLUDE_NGSLIB_BAM_PILEUP_H__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include <htslib/sam.h>
+#include "ngslib/bam.h"
+#include "ngslib/bam_header.h"
+#include "ngslib/read_filter.h"
+#include "ngslib/region.h"
+#include "ngslib/thread_pool.h"
+
+namespace ngslib {
+
+    /* The reads of one sample covering one position, the i-th element of all
+     * the arrays is from the same read.
+     *
+     * The arrays are reused by every column, they are cleared but never shrink,
+     * so no memory is allocated per column once they are large enough.
+     * */
+    struct PileupColumn {
+        // 'A', 'C', 'G', 'T', 'N' (as seq_nt16_str), '*' for a deletion, or
+        // '>' for a reference skip (N in CIGAR).
+        std::vector<char> bases;
+        std::vector<uint8_t> quals;     // Base quality, 0 for deletion and reference skip.
+        std::vector<uint8_t> mapqs;     // Mapping quality of the read.
+        std::vector<uint8_t> reverse;   // 1 if the read is mapped to the reverse strand.
+
+        // Indel after this position: > 0 insertion length, < 0 deletion length,
+        // 0 for none. The same as bam_pileup1_t::indel.
+        std::vector<int> indels;
+        std::vector<int32_t> qpos;      // The position of base on read, 0-based.
+        // The reads, valid until the next column. Aux tags are not decoded for CRAM.
+        std::vector<const bam1_t *> reads;
+
+        size_t size() const { return bases.size(); }
+
+        bool empty() const { return bases.empty(); }
+
+        void clear() {
+            bases.clear();
+            quals.clear();
+            mapqs.clear();
+            reverse.clear();
+            indels.clear();
+            qpos.clear();
+            reads.clear();
+        }
+    };
+
+    /* Pileup of one or more (multi-sample, like `samtools mpileup`) BAM/CRAM
+     * files by bam_mplp in htslib.
+     *
+     * For each covered position, next() fills one PileupColumn per file:
+     *
+     *      BamPileup plp(fns);
+     *      plp.fetch("chr1:10000-20000");
+     *      while (plp.next() >= 0) {
+     *          for (size_t i = 0; i < plp.size(); ++i) {
+     *              const PileupColumn &c = plp.column(i);
+     *              ...  // c.bases[j], c.quals[j] of the j-th read
+     *          }
+     *      }
+     *
+     * Reads failing the read filter (default: unmapped, secondary, QC failed
+     * and duplicate, the same as mpileup) are skipped before going into the
+     * pileup, bases with quality < min_baseq are not put in columns. The
+     * overlapping bases of the two mates of a pair are only counted once: the
+     * quality of the lower one is set to 0 by bam_mplp_init_overlaps(), which
+     * is removed by min_baseq then.
+     *
+     * All the files must have the same reference sequences.
+     * */
+    class BamPileup {
+
+    private:
+        struct _Sample {
+            std::unique_ptr<Bam> bam;
+            hts_itr_t *itr;  // NULL to read the whole file.
+            const ReadFilter *filter;
+
+            _Sample() : itr(NULL), filter(NULL) {}
+            ~_Sample() { if (itr) sam_itr_destroy(itr); }
+        };
+
+        std::vector<std::unique_ptr<_Sample> > _samples;
+        bam_mplp_t _mplp;
+
+        ReadFilter _filter;
+        int _min_baseq;
+        int _max_depth;
+        bool _overlaps;     // Detect the overlapping mate pairs.
+
+        GenomeRegion _region;  // Only output the columns in it if tid >= 0.
+
+        int _tid;
+        hts_pos_t _pos;
+        std::vector<int> _n_plp;
+        std::vector<const bam_pileup1_t *> _plp;
+        std::vector<PileupColumn> _columns;
+
+        // Callback of bam_mplp to read one record of a sample.
+        static int _read(void *data, bam1_t *b);
+
+        // (Re)create the bam_mplp_t for reading from the beginning.
+        void _init_mplp();
+        void _fill_column(size_t i);
+
+        BamPileup(const BamPileup &p) = delete;             // reject using copy constructor (C++11 style).
+        BamPileup &operator=(const BamPileup &p) = delete;  // reject using copy/assignment operator (C++11 style).
+
+    public:
+        /** Pileup one or more SAM/BAM/CRAM files.
+         *
+         * @param fns       The files, one column per file for each position.
+         * @param nthreads  The number of threads shared by all the files for
+         *                  decompression. Default: 0, no extra thread.
+         *
+         * @exception Throws an invalid_argument if any file could not be opened
+         * or the reference sequences of files are different.
+         */
+        explicit BamPileup(const std::vector<std::string> &fns, int nthreads = 0);
+        explicit BamPileup(const std::string &fn, int nthreads = 0);
+
+        ~BamPileup();
+
+        // Reads failing it are not in pileup, call it before next().
+        // Default: ReadFilter(0, BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP).
+        void set_filter(const ReadFilter &filter) { _filter = filter; }
+
+        // Bases with quality < min_baseq are not in columns. Default: 13.
+        void set_min_baseq(int min_baseq) { _min_baseq = min_baseq; }
+
+        // At most `max_depth` reads of a file at one position. Default: 8000.
+        void set_max_depth(int max_depth);
+
+        // Count the overlapping bases of mate pairs only once. Default: true.
+        void set_overlaps(bool overlaps);
+
+        /** Only output the columns in region, all the files must be indexed.
+         *  See Bam::fetch() for the format of region. The pileup starts over.
+         *
+         * @exception Throws an invalid_argument if the region is invalid.
+         */
+        BamPileup &fetch(const std::string &region);
+
+        /** Move to the next column.
+         *
+         * @return 0 on success, -1 if there is no more column, < -1 on error.
+         */
+        int next();
+
+        // The number of files, which is also the number of columns per position.
+        size_t size() const { return _samples.size(); }
+
+        // The header of the first file.
+        BamHeader &header() { return _samples[0]->bam->header(); }
+
+        // The reference id and 0-based position of the current columns.
+        int tid() const { return _tid; }
+        hts_pos_t pos() const { return _pos; }
+
+        // The column of i-th file at current position.
+        const PileupColumn &column(size_t i) const { return _columns[i]; }
+
+        // The total depth of all files at current position.
+        size_t depth() const;
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_BAM_PILEUP_H__
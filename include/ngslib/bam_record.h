@@ -10,6 +10,9 @@
 
 #include <htslib/sam.h>
 #include "ngslib/bam_header.h"
+#include "ngslib/cigar_view.h"
+#include "ngslib/read_filter.h"
+#include "ngslib/seq_kernels.h"
 
 
 namespace ngslib {
@@ -28,41 +31,98 @@ namespace ngslib {
                                     'T', ' ', ' ', ' ',
                                     ' ', ' ', ' ', 'N'};
 
+    /*! The fields of an alignment record, which could be OR'ed together to
+     *  declare the fields a caller is going to use, see Bam::set_fields().
+     *  The values are the same as SAM_QNAME ... SAM_RGAUX in sam.h.
+     *
+     *  RGAUX means only the RG tag of aux fields.
+     **/
+    struct Fields {
+        enum {
+            QNAME = SAM_QNAME,
+            FLAG  = SAM_FLAG,
+            RNAME = SAM_RNAME,
+            POS   = SAM_POS,
+            MAPQ  = SAM_MAPQ,
+            CIGAR = SAM_CIGAR,
+            RNEXT = SAM_RNEXT,
+            PNEXT = SAM_PNEXT,
+            TLEN  = SAM_TLEN,
+            SEQ   = SAM_SEQ,
+            QUAL  = SAM_QUAL,
+            AUX   = SAM_AUX,
+            RGAUX = SAM_RGAUX,
+            ALL   = SAM_QNAME | SAM_FLAG | SAM_RNAME | SAM_POS | SAM_MAPQ | SAM_CIGAR | SAM_RNEXT |
+                    SAM_PNEXT | SAM_TLEN | SAM_SEQ | SAM_QUAL | SAM_AUX | SAM_RGAUX
+        };
+    };
+
+    /* A zero-copy view of a B-array aux tag, e.g. "ZB:B:c,1,2,3".
+     *
+     * @field type  The type of elements: one of "cCsSiIf"
+     * @field n     The number of elements
+     * @field data  The packed little-endian elements in the record
+     * */
+    struct AuxArray {
+        char type;
+        uint32_t n;
+        const uint8_t *data;
+
+        AuxArray() : type(0), n(0), data(NULL) {}
+
+        // The i-th element as an integer or a float, whatever `type` is.
+        int64_t int_at(uint32_t i) const;
+        double float_at(uint32_t i) const;
+    };
+
     class BamRecord {
 
     private:
         /// bam record, the most and only important member of BamRecord
         bam1_t *_b;
 
-        /** Define a structure for CIGAR op by type BAM_CIGAR_STR (MIDNSHP=XB)
-         * and length.
-         * @param op    CIGAR op (MIDNSHP=XB)
-         * @param len   CIGAR length
-         * */
-        typedef struct {
-            char op;
-            unsigned int len;
-        } CigarField;
-
-        // A pointer to CigarField array.
-        CigarField *_p_cigar_field;
-
-        // The number of CIGAR operator, which is the size of CigarField array.
-        unsigned int _n_cigar_op;
-
-        /* Make cigar field by CIGAR of this alignment */
-        void _make_cigar_field();
+        // The fields decoded in _b, see Fields.
+        int _fields;
+
+        /* An index of the aux tags: the tag and the offset of its type byte in
+         * _b->data, built by index_tags() in one pass. It's dropped once the
+         * record is replaced or handed out by the non-const b(), and not used
+         * if the aux data is resized or moved. The lookups scan the aux data by
+         * bam_aux_get() without it, or if a record has more than
+         * AUX_INDEX_SIZE tags. */
+        static const int AUX_INDEX_SIZE = 16;
+        int _n_aux;  // -1 if not built, AUX_INDEX_SIZE + 1 if too many tags
+        uint16_t _aux_tag[AUX_INDEX_SIZE];
+        uint32_t _aux_off[AUX_INDEX_SIZE];
+        const uint8_t *_aux_data;  // _b->data and _b->l_data when it's built
+        int _aux_l_data;
+
+        // The type byte of `tag` (as bam_aux_get()), NULL if it's not found.
+        const uint8_t *_aux(const std::string &tag, const char *func) const;
+
+        // Throws an invalid_argument if any of `fields` is not decoded.
+        void _check_fields(int fields, const char *func) const {
+            if ((_fields & fields) != fields) _undecoded(fields, func);
+        }
 
-        /* get the max size of Op in cigar */
-        unsigned int _max_cigar_Opsize(const char op) const;
+        void _undecoded(int fields, const char *func) const;
 
     public:
         BamRecord();  // initial to be NULL.
         ~BamRecord() { destroy(); }
 
-        BamRecord(const BamRecord &b);  // copy constructor
+        BamRecord(const BamRecord &b);  // copy constructor, a deep copy of bam1_t
         BamRecord &operator=(const BamRecord &b);
 
+        // Move constructor and assignment, only the bam1_t pointer is taken
+        // over and `b` is left empty. So a std::vector<BamRecord> moves its
+        // records instead of duplicating them when it grows.
+        BamRecord(BamRecord &&b) noexcept : _b(b._b), _fields(b._fields), _n_aux(-1) { b._b = NULL; }
+        BamRecord &operator=(BamRecord &&b) noexcept;
+
+        // An explicit deep copy.
+        BamRecord clone() const { return BamRecord(*this); }
+
         BamRecord(const bam1_t *b);
 
         BamRecord &operator=(const bam1_t *b);
@@ -71,6 +131,13 @@ namespace ngslib {
 
         void destroy();
 
+        /** Replace the bam1_t of this record by `b` without copying, and return
+         *  the previous one (may be NULL). The ownership of both pointers are
+         *  exchanged, so readers could hand over decoded records cheaply.
+         *  `fields` are the fields decoded in `b`, see Fields.
+         */
+        bam1_t *exchange(bam1_t *b, int fields = Fields::ALL);
+
         /**************************
          *** Exported functions ***
          **************************/
@@ -82,27 +149,43 @@ namespace ngslib {
          *
          *  @param fp   Pointer to the source file
          *  @param h    Pointer to the header previously read (fully or partially)
+         *  @param fields  The fields decoded by `fp`, see Bam::set_fields().
+         *  @param filter  Skip the records failing this filter if it's not NULL.
          *  @return >= 0 on successfully reading a new record, -1 on end of
          *  stream, < -1 on error.
          *
          **/
-        int load_read(samFile *fp, sam_hdr_t *h);
+        int load_read(samFile *fp, sam_hdr_t *h, int fields = Fields::ALL, const ReadFilter *filter = NULL);
 
         /** Call sam_itr_next() function of sam.h to get iterator the next
          *  read by a SAM/BAM/CRAM iterator.
          *
          *  @param fp       samFile pointer to the source file
          *  @param itr      Iterator
+         *  @param fields   The fields decoded by `fp`, see Bam::set_fields().
+         *  @param filter   Skip the records failing this filter if it's not NULL.
          *  @return >= 0 on success; -1 when there is no more data; < -1 on error.
          *
          **/
-        int next_read(samFile *fp, hts_itr_t *itr);
+        int next_read(samFile *fp, hts_itr_t *itr, int fields = Fields::ALL, const ReadFilter *filter = NULL);
 
         // -- END the two TOP level functions --
 
         // conversion function
         operator bool() const { return bool(_b != NULL); }
 
+        // return the `bam1_t` pointer of this alignment record. The tag index
+        // is dropped by the non-const one, as the record may be changed by it.
+        bam1_t *b() { _n_aux = -1; return _b; }
+        const bam1_t *b() const { return _b; }
+
+        /** The fields decoded in this record, see Fields. The accessors of an
+         *  undecoded field throw an invalid_argument instead of returning junk.
+         */
+        int fields() const { return _fields; }
+
+        bool has_fields(int fields) const { return (_fields & fields) == fields; }
+
         friend std::ostream &operator<<(std::ostream &os, const BamRecord &b);
 
         /// 12 inline functions for dealing with FLAG of BAM alignment record
@@ -165,20 +248,24 @@ namespace ngslib {
 
         /* Get the alignment chromosome of this read */
         std::string tid_name(const BamHeader &hdr) const {
+            _check_fields(Fields::RNAME, "tid_name");
             return is_mapped() ? hdr.seq_name(_b->core.tid) : "";
         }
 
         // hts_pos_t is a alisa name of int64_t defined in hts.h.
         hts_pos_t tid_length(const BamHeader &hdr) const {
+            _check_fields(Fields::RNAME, "tid_length");
             return is_mapped() ? hdr.seq_length(_b->core.tid) : -1;
         }
 
         /* Get the alignment chromosome of mate read */
         std::string mate_tid_name(const BamHeader &hdr) const {
+            _check_fields(Fields::RNEXT, "mate_tid_name");
             return is_mate_mapped() ? hdr.seq_name(_b->core.mtid) : "";
         }
 
         hts_pos_t mate_tid_length(const BamHeader &hdr) const {
+            _check_fields(Fields::RNEXT, "mate_tid_length");
             return is_mate_mapped() ? hdr.seq_length(_b->core.mtid) : -1;
         }
 
@@ -188,10 +275,16 @@ namespace ngslib {
         uint16_t flag() const { return _b->core.flag; }
 
         /* Get the id of alignment chromosome, defined by sam_hdr_t */
-        int32_t tid() const { return is_mapped() ? _b->core.tid : -1; }
+        int32_t tid() const {
+            _check_fields(Fields::RNAME, "tid");
+            return is_mapped() ? _b->core.tid : -1;
+        }
 
         /* chromosome ID of mate read in template, defined by sam_hdr_t */
-        int32_t mate_tid() const { return is_mate_mapped() ? _b->core.mtid : -1; }
+        int32_t mate_tid() const {
+            _check_fields(Fields::RNEXT, "mate_tid");
+            return is_mate_mapped() ? _b->core.mtid : -1;
+        }
 
         /* Get the alignment strand of this read, Should be one of '*', '-', '+' */
         char map_strand() const {
@@ -209,6 +302,7 @@ namespace ngslib {
         hts_pos_t reference_start_pos() const {
             // Return the leftmost position of an alignment on the reference
             // genome, 0-based coordinate
+            _check_fields(Fields::POS, "reference_start_pos");
             return is_mapped() ? _b->core.pos : -1;
         }
 
@@ -224,6 +318,7 @@ namespace ngslib {
          * we return b->core.pos + 1 by convention.
          */
         hts_pos_t reference_end_pos() const {
+            _check_fields(Fields::POS | Fields::CIGAR, "reference_end_pos");
             return is_mapped() ? bam_endpos(_b) : -1;
         }
 
@@ -232,15 +327,26 @@ namespace ngslib {
          * */
         hts_pos_t mate_reference_start_pos() const {
             // 0-based leftmost coordinate of next read in template
+            _check_fields(Fields::PNEXT, "mate_reference_start_pos");
             return is_mate_mapped() ? _b->core.mpos : -1;
         }
 
         /* Get mapping quality */
-        int mapq() const { return is_mapped() ? _b->core.qual : 0; }
+        int mapq() const {
+            _check_fields(Fields::MAPQ, "mapq");
+            return is_mapped() ? _b->core.qual : 0;
+        }
 
         /* convert CIGAR to a string */
         std::string cigar() const;
 
+        /* A zero-copy view of CIGAR, empty for an unmapped read. It's valid
+         * until the next record is read into this one. */
+        CigarView cigar_view() const {
+            _check_fields(Fields::CIGAR, "cigar_view");
+            return is_mapped() ? CigarView(_b) : CigarView();
+        }
+
         /*
          * Return the number of "aligned bases" exclude the base mark as I, D, N,
          * S, H, and P in CIGAR.
@@ -257,11 +363,17 @@ namespace ngslib {
         unsigned int max_deletion_size() const;
 
         /* Get insert size */
-        hts_pos_t insert_size() const { return is_paired() ? _b->core.isize : 0; }
+        hts_pos_t insert_size() const {
+            _check_fields(Fields::TLEN, "insert_size");
+            return is_paired() ? _b->core.isize : 0;
+        }
 
         /// Functions for the alignment query information
         /* Get the read ID as a string */
-        std::string qname() const { return std::string(bam_get_qname(_b)); }
+        std::string qname() const {
+            _check_fields(Fields::QNAME, "qname");
+            return std::string(bam_get_qname(_b));
+        }
 
         /* Get the length of read */
         int query_length() const { return _b ? _b->core.l_qseq : -1; }
@@ -269,6 +381,13 @@ namespace ngslib {
         /* Retrieve the sequencing bases of this read as a string (ACTGN) */
         std::string query_sequence() const;
 
+        /* Decode the bases into `seq`, which is reused from record to record so
+         * no memory is allocated once it's large enough. The reverse complement
+         * is decoded if `reverse_complement`, e.g. the original read of a read
+         * mapped to the reverse strand. Decoded by SIMD, see seq_kernels.h.
+         * */
+        void query_sequence(std::string &seq, bool reverse_complement = false) const;
+
         /* Retrieve the sequencing qualities of this read as a string
          *
          * @param offset Encoding offset for Phred quality scores. Default 33
@@ -278,9 +397,17 @@ namespace ngslib {
          * */
         std::string query_qual(int offset = 33) const;
 
+        /* Decode the qualities into the reusable `qual`, in the reverse order
+         * if `reverse`. The same as query_qual() above otherwise. */
+        void query_qual(std::string &qual, int offset = 33, bool reverse = false) const;
+
         /* Calculate the mean sequencing quality of the whole read */
         double mean_qqual() const;
 
+        /* The sum, min and the number of qualities < `threshold` of the whole
+         * read in one SIMD pass, see QualStats. */
+        QualStats qual_stats(int threshold = 20) const;
+
         /* Get the alignment start position on this read, by removing soft-clips.
          *
          * @return 0-base position on the read on success, -1 on NULL.
@@ -317,6 +444,40 @@ namespace ngslib {
         /* has a specific TAG in the alignment or not */
         bool has_tag(const std::string tag) const;
 
+        /// Typed aux tags without copy or conversion through strings. The first
+        /// lookup scans the aux data, unless index_tags() has been called: then
+        /// all the tags are indexed in one pass and the lookups search the small
+        /// index, so fetching several tags of a record costs one scan and no
+        /// allocation. The lookups only read the record, they are safe to be
+        /// called on the same record by threads.
+
+        /* Index the aux tags of this record for the lookups below. */
+        void index_tags();
+
+        /* The type of `tag`: one of "AcCsSiIfdZHB", 0 if it's not found. */
+        char tag_type(const std::string &tag) const;
+
+        /** Get an integer tag of type c, C, s, S, i or I.
+         * @return false if the tag is not found or is not an integer.
+         */
+        bool get_int_tag(const std::string &tag, int64_t &value) const;
+
+        /** Get a float tag of type f or d.
+         * @return false if the tag is not found or is not a float.
+         */
+        bool get_float_tag(const std::string &tag, double &value) const;
+
+        /** Get a string tag of type Z or H in the record, no copy.
+         * @return NULL if the tag is not found or is not a string. The pointer
+         *         is valid until the record is changed.
+         */
+        const char *get_string_tag(const std::string &tag) const;
+
+        /** Get a B-array tag in the record, no copy.
+         * @return false if the tag is not found or is not an array.
+         */
+        bool get_array_tag(const std::string &tag, AuxArray &array) const;
+
         /** Get a string (Z) tag
          * @param tag Name of the tag. eg "XP"
          * @param s The string to be filled in with the tag information
@@ -0,0 +1,108 @@
+// The C++ codes for scanning a BAM/CRAM file by many threads
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_BAM_SCANNER_H__
+#define __INCLUDE_NGSLIB_BAM_SCANNER_H__
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "ngslib/bam.h"
+#include "ngslib/bam_record.h"
+#include "ngslib/region.h"
+
+namespace ngslib {
+
+    struct _WorkQueues;  // Shard queues of workers, defined in bam_scanner.cpp
+
+    /* Scan an indexed BAM/CRAM file in parallel.
+     *
+     * The genome is split into shards which are handed to N worker threads.
+     * Every worker opens its own file handle and iterator (_fp and _itr in Bam
+     * are not thread safe), but all of them share one loaded BAI/CSI index.
+     * A CRAM index is tied to the file handle which loaded it, so each worker
+     * loads its own .crai instead.
+     *
+     * The shards of BAM are balanced by the compressed bytes estimated from
+     * index (see split_genome_by_bytes()), so a worker on a deep region does
+     * not lag behind the others. Shards are first dealt out to workers in
+     * contiguous blocks to keep the disk access sequential, an idle worker
+     * then steals the last shard from the queues of the others (work-stealing).
+     *
+     * A record belongs to the shard containing its start position. The fetch
+     * of a shard also returns the reads spanning its start, which are owned by
+     * the previous shard, they are skipped by the start position without being
+     * passed to the callback. So every record is visited exactly once, as long
+     * as the shards tile the genome, see set_owned_only().
+     * */
+    class BamScanner {
+
+    public:
+        /** Called for each record in a shard. Called concurrently by different
+         *  workers, use `worker_id` (0 ~ nthreads-1) to keep per-thread results.
+         */
+        typedef std::function<void(const GenomeRegion &shard, const BamRecord &br,
+                                   int worker_id)> RecordCallback;
+
+    private:
+        std::string _fname;
+        int _nthreads;
+        bool _is_cram;
+        bool _owned_only;
+
+        Bam _bam;        // Hold the shared index and the header.
+        std::vector<GenomeRegion> _shards;
+
+        void _scan(int worker_id, _WorkQueues &work, const RecordCallback &callback,
+                   size_t &n_record);
+
+        BamScanner(const BamScanner &bs) = delete;             // reject using copy constructor (C++11 style).
+        BamScanner &operator=(const BamScanner &bs) = delete;  // reject using copy/assignment operator (C++11 style).
+
+    public:
+        /** Create a scanner for an indexed BAM/CRAM file.
+         *
+         * @param fn               The BAM/CRAM file name
+         * @param nthreads         Number of worker threads, must be > 0
+         * @param shard_size       The genome is split into as many shards as cutting
+         *                         it by this length (bp), but the shards of BAM
+         *                         are balanced by bytes. Default: 10Mb
+         * @param include_unmapped Scan the unmapped reads at the end of file as
+         *                         the last shard or not. Default: false
+         *
+         * @exception Throws an invalid_argument if file could not be opened or
+         * the index is not available.
+         */
+        BamScanner(const std::string &fn, int nthreads, hts_pos_t shard_size = 10000000,
+                   bool include_unmapped = false);
+
+        // Replace the shards created by the constructor.
+        void set_shards(const std::vector<GenomeRegion> &shards) { _shards = shards; }
+
+        /** Skip the reads starting before the shard (default: true). Set false
+         *  if the shards do not tile the genome, e.g. targets in a BED, then a
+         *  read spanning two shards is visited by both of them, as what
+         *  BamIterator::fetch() does for each region.
+         */
+        void set_owned_only(bool owned_only) { _owned_only = owned_only; }
+
+        const std::vector<GenomeRegion> &shards() const { return _shards; }
+
+        BamHeader &header() { return _bam.header(); }
+
+        /** Scan all the shards by the worker threads.
+         *
+         * @param callback  Function called for each record.
+         * @return the total number of records visited.
+         *
+         * @exception Rethrow the first exception raised by a worker (or by the
+         * callback) after all the workers have stopped.
+         */
+        size_t run(const RecordCallback &callback);
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_BAM_SCANNER_H__
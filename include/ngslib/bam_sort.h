@@ -0,0 +1,122 @@
+// The C++ codes for sorting BAM/CRAM files with bounded memory
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_BAM_SORT_H__
+#define __INCLUDE_NGSLIB_BAM_SORT_H__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include <htslib/sam.h>
+#include "ngslib/bam_header.h"
+
+namespace ngslib {
+
+    struct SortOrder {
+        enum {
+            COORDINATE,  // (tid, pos, strand), unmapped reads without coordinate at the end
+            QUERYNAME    // Read names in natural order (numbers compared by value), READ1 first
+        };
+    };
+
+    /// Compare two read names in natural order, like `samtools sort -n`.
+    /** "r9" goes before "r10", the digits are compared by value.
+     *
+     *  @return < 0, 0 or > 0 if `a` is less than, equal to or greater than `b`.
+     */
+    int strnum_cmp(const char *a, const char *b);
+
+    // true if record `a` goes before `b` in coordinate order.
+    bool coordinate_less(const bam1_t *a, const bam1_t *b);
+
+    // true if record `a` goes before `b` in queryname order.
+    bool queryname_less(const bam1_t *a, const bam1_t *b);
+
+    /* Sort a SAM/BAM/CRAM file with a strict memory budget, like `samtools sort`.
+     *
+     * Records are packed into an arena of `max_memory` bytes. Once it is full,
+     * the records are sorted in memory: chunks are sorted by the worker threads
+     * and merged pairwise in parallel. Then the sorted run is written to a
+     * temporary BAM with fast compression (level 1). At the end, the runs
+     * are merged into the output by MultiBam with a bounded number of open
+     * files. Decompression of runs and compression of output share one thread
+     * pool. The output could be indexed on the fly. An input which fits in
+     * memory is written out directly without any temporary file.
+     *
+     * The sort is stable: records with the same key are in input order.
+     * */
+    class BamSorter {
+
+    private:
+        std::string _fname;
+        int _order;
+        size_t _max_memory;
+        int _nthreads;
+        std::string _tmp_prefix;
+        std::string _reference;
+        bool _index;
+        int _min_shift;
+        size_t _max_open;
+
+        size_t _n_records;
+        std::vector<std::string> _runs;
+
+        BamSorter(const BamSorter &s) = delete;             // reject using copy constructor (C++11 style).
+        BamSorter &operator=(const BamSorter &s) = delete;  // reject using copy/assignment operator (C++11 style).
+
+    public:
+        /**
+         * @param fn     The SAM/BAM/CRAM file to sort
+         * @param order  SortOrder::COORDINATE (default) or SortOrder::QUERYNAME
+         *
+         * @exception Throws an invalid_argument if order is unknown.
+         */
+        explicit BamSorter(const std::string &fn, int order = SortOrder::COORDINATE);
+
+        ~BamSorter();
+
+        // The memory (bytes) to hold records, at least 1Mb. Default: 768Mb.
+        void set_max_memory(size_t bytes);
+
+        // The number of threads for sorting and (de)compression. Default: 1.
+        void set_threads(int nthreads);
+
+        // Temporary files are named <prefix>.<n>.bam. Default: <output>.tmp
+        void set_tmp_prefix(const std::string &prefix) { _tmp_prefix = prefix; }
+
+        // The FASTA reference for CRAM output.
+        void set_reference(const std::string &fa) { _reference = fa; }
+
+        /** Index the output on the fly, only for coordinate order. `min_shift`
+         *  > 0 for CSI instead of BAI, see BamWriter::set_index().
+         */
+        void set_index(bool index, int min_shift = 0);
+
+        // The max number of temporary files kept open in merging. Default: 256.
+        void set_max_open(size_t n) { _max_open = n; }
+
+        /** Sort the records and write them to `out_fn`.
+         *
+         * @param out_fn  The output file
+         * @param mode    "wb" for BAM (default), "wc" for CRAM, see BamWriter.
+         * @return the number of records.
+         *
+         * @exception Throws an invalid_argument if any file fails.
+         */
+        size_t run(const std::string &out_fn, const std::string &mode = "wb");
+
+        // The number of temporary runs spilled by the last run().
+        size_t n_runs() const { return _runs.size(); }
+    };
+
+    /// Sort `in_fn` to `out_fn` by BamSorter, see above.
+    /** @return the number of records. */
+    size_t sort(const std::string &in_fn, const std::string &out_fn, int order = SortOrder::COORDINATE,
+                size_t max_memory = 768 << 20, int nthreads = 1);
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_BAM_SORT_H__
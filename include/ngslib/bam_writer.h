@@ -0,0 +1,153 @@
+// The C++ codes for writing BAM/SAM/CRAM file
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_BAM_WRITER_H__
+#define __INCLUDE_NGSLIB_BAM_WRITER_H__
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <htslib/sam.h>
+#include "ngslib/bam_header.h"
+#include "ngslib/bam_record.h"
+#include "ngslib/thread_pool.h"
+
+namespace ngslib {
+
+    struct _WriteBuffer;  // A batch of bam1_t waiting to be written, defined in bam_writer.cpp
+
+    /* A BAM/SAM/CRAM file writer.
+     *
+     * write() copies the record into a batch owned by the writer and returns
+     * immediately. Full batches are queued to a background thread, which calls
+     * sam_write1() and hands the BGZF blocks (or CRAM containers) to the thread
+     * pool for compression. So the caller only blocks on the copy, or when the
+     * queue is full because compression can not keep up.
+     *
+     * The bam1_t of batches are recycled after written, no malloc per record in
+     * the steady state.
+     * */
+    class BamWriter {
+
+    private:
+        std::string _fname;  // output file name
+        std::string _mode;   // Mode matching / w[bcuz0-9]* /
+
+        samFile *_fp;
+        BamHeader _hdr;
+        SharedThreadPool _tpool;
+        bool _header_written;
+
+        bool _index;                           // Build the index on the fly.
+        int _min_shift;
+        std::string _fnidx;
+
+        size_t _batch_size;                    // The number of records in one batch
+        size_t _queue_depth;                   // The max number of batches in _queue
+        _WriteBuffer *_batch;                  // The batch filling by write()
+        std::deque<_WriteBuffer *> _queue;     // Batches waiting to be written
+        std::vector<_WriteBuffer *> _recycle;  // Batches have been written
+
+        std::mutex _lock;
+        std::condition_variable _not_empty;
+        std::condition_variable _not_full;
+        std::thread _writer;
+        bool _stop;
+        std::atomic<int> _io_status;
+
+        void _open(const std::string &fn, const std::string &mode, const BamHeader &hdr,
+                   const SharedThreadPool &tp);
+
+        // Write header and start the background thread.
+        void _start();
+
+        // Queue the current batch and take a recycled one.
+        void _submit();
+
+        // The loop of background thread.
+        void _write_loop();
+
+        BamWriter(const BamWriter &bw) = delete;             // reject using copy constructor (C++11 style).
+        BamWriter &operator=(const BamWriter &bw) = delete;  // reject using copy/assignment operator (C++11 style).
+
+    public:
+        /** Create a writer.
+         *
+         * @param fn        The output file name, "-" for stdout
+         * @param hdr       The header to write
+         * @param mode      "wb" for BAM (default), "wc" for CRAM, "w" for SAM, and
+         *                  a compression level could be added, e.g. "wb1"
+         * @param nthreads  Create a private pool with `nthreads` threads for
+         *                  compression if > 0. Default: 0, no extra thread.
+         *
+         * @exception Throws an invalid_argument if file could not be opened.
+         */
+        BamWriter(const std::string &fn, const BamHeader &hdr, const std::string &mode = "wb",
+                  int nthreads = 0);
+
+        // Create a writer with a thread pool which may be shared with other files.
+        BamWriter(const std::string &fn, const BamHeader &hdr, const std::string &mode,
+                  const SharedThreadPool &tp);
+
+        ~BamWriter() { close(); }
+
+        /** Set the FASTA reference, which is required by CRAM. Call it before
+         *  writing any record.
+         *
+         * @exception Throws an invalid_argument if reference could not be set.
+         */
+        void set_reference(const std::string &fa);
+
+        /** Set the size of batch and the max number of batches in the queue.
+         *  Call it before writing any record. Default: 4096 records, 4 batches.
+         */
+        void set_buffer(size_t batch_size, size_t queue_depth);
+
+        /** Build the index while writing, and save it by close(). Call it
+         *  before writing any record, the records must be sorted by coordinate.
+         *
+         * @param min_shift  0 for BAI, > 0 for CSI with this min_shift (14 is
+         *                   the common one). CRAM is always indexed by CRAI.
+         * @param fnidx      The index file name. Default: <fn>.bai, <fn>.csi or
+         *                   <fn>.crai
+         *
+         * @exception Throws an invalid_argument if it's called too late.
+         */
+        void set_index(int min_shift = 0, const std::string &fnidx = "");
+
+        /** Queue a record to be written.
+         *
+         * @return 0 on success, -1 if record is empty or an error occurred in
+         *         the background (check it again after close()).
+         */
+        int write(const BamRecord &br);
+
+        // Queue a raw record, the same as write(BamRecord).
+        int write(const bam1_t *b);
+
+        /** Flush all the queued records, stop the background thread, save the
+         *  index if set_index() and close the file. It's called by destructor
+         *  automatically.
+         *
+         * @return 0 if all the records have been written, -1 on error.
+         */
+        int close();
+
+        // 0 if everything is OK, -1 on error.
+        int io_status() const { return _io_status; }
+
+        BamHeader &header() { return _hdr; }
+
+        friend std::ostream &operator<<(std::ostream &os, const BamWriter &w);
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_BAM_WRITER_H__
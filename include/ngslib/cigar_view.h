@@ -0,0 +1,151 @@
+// The C++ codes for a read-only view of CIGAR in BAM record
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_CIGAR_VIEW_H__
+#define __INCLUDE_NGSLIB_CIGAR_VIEW_H__
+
+#include <string>
+#include <iterator>
+#include <cstddef>
+#include <stdint.h>
+
+#include <htslib/sam.h>
+
+namespace ngslib {
+
+    /* One CIGAR operation, a packed uint32_t as it is in bam1_t: the length in
+     * the upper 28 bits and the type (BAM_CMATCH, BAM_CINS, ...) in the lower
+     * 4 bits.
+     * */
+    struct CigarOp {
+        uint32_t v;
+
+        CigarOp(uint32_t c = 0) : v(c) {}
+
+        int type() const { return bam_cigar_op(v); }                 // BAM_CMATCH, BAM_CINS, ...
+        char op() const { return bam_cigar_opchr(v); }               // One of "MIDNSHP=XB"
+        uint32_t len() const { return bam_cigar_oplen(v); }
+
+        bool consumes_query() const { return bam_cigar_type(type()) & 1; }
+        bool consumes_reference() const { return bam_cigar_type(type()) & 2; }
+    };
+
+    /* A zero-copy view of the CIGAR of a bam1_t, nothing is allocated or
+     * converted. It's valid as long as the record is not changed (read over
+     * or destroyed), so do not keep it across records.
+     * */
+    class CigarView {
+
+    private:
+        const uint32_t *_c;
+        uint32_t _n;
+
+    public:
+        // The operations are decoded on the fly, so it hands out CigarOp by
+        // value, and operator-> goes through a copy held by a proxy.
+        class const_iterator {
+        private:
+            const uint32_t *_p;
+
+        public:
+            struct arrow_proxy {
+                CigarOp op;
+                const CigarOp *operator->() const { return &op; }
+            };
+
+            typedef std::bidirectional_iterator_tag iterator_category;
+            typedef CigarOp value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef arrow_proxy pointer;
+            typedef CigarOp reference;
+
+            explicit const_iterator(const uint32_t *p = NULL) : _p(p) {}
+
+            CigarOp operator*() const { return CigarOp(*_p); }
+            arrow_proxy operator->() const { arrow_proxy a = {CigarOp(*_p)}; return a; }
+
+            const_iterator &operator++() { ++_p; return *this; }
+            const_iterator operator++(int) { const_iterator t = *this; ++_p; return t; }
+            const_iterator &operator--() { --_p; return *this; }
+            const_iterator operator--(int) { const_iterator t = *this; --_p; return t; }
+
+            bool operator==(const const_iterator &it) const { return _p == it._p; }
+            bool operator!=(const const_iterator &it) const { return _p != it._p; }
+        };
+
+        CigarView() : _c(NULL), _n(0) {}
+        CigarView(const uint32_t *c, uint32_t n) : _c(c), _n(n) {}
+
+        // The CIGAR of `b`, empty if `b` is NULL.
+        explicit CigarView(const bam1_t *b) : _c(b ? bam_get_cigar(b) : NULL), _n(b ? b->core.n_cigar : 0) {}
+
+        uint32_t size() const { return _n; }
+        bool empty() const { return _n == 0; }
+
+        CigarOp operator[](uint32_t i) const { return CigarOp(_c[i]); }
+        CigarOp front() const { return CigarOp(_c[0]); }
+        CigarOp back() const { return CigarOp(_c[_n - 1]); }
+
+        // The packed operations, see bam_get_cigar().
+        const uint32_t *data() const { return _c; }
+
+        const_iterator begin() const { return const_iterator(_c); }
+        const_iterator end() const { return const_iterator(_c + _n); }
+
+        /// Single-pass scans over the packed operations.
+
+        // The total length of operations of `type`, e.g. BAM_CMATCH.
+        uint32_t sum(int type) const {
+            uint32_t s = 0;
+            for (uint32_t i = 0; i < _n; ++i) {
+                if ((int)bam_cigar_op(_c[i]) == type) s += bam_cigar_oplen(_c[i]);
+            }
+            return s;
+        }
+
+        // The max length of operations of `type`, 0 if there's none.
+        uint32_t max(int type) const {
+            uint32_t m = 0;
+            for (uint32_t i = 0; i < _n; ++i) {
+                if ((int)bam_cigar_op(_c[i]) == type && bam_cigar_oplen(_c[i]) > m) m = bam_cigar_oplen(_c[i]);
+            }
+            return m;
+        }
+
+        // The number of aligned bases: M, = and X.
+        uint32_t aligned_length() const {
+            uint32_t s = 0;
+            for (uint32_t i = 0; i < _n; ++i) {
+                int t = bam_cigar_op(_c[i]);
+                if (t == BAM_CMATCH || t == BAM_CEQUAL || t == BAM_CDIFF) s += bam_cigar_oplen(_c[i]);
+            }
+            return s;
+        }
+
+        // The soft-clipped bases at the head and at the tail of read.
+        uint32_t head_soft_clip() const {
+            uint32_t s = 0;
+            for (uint32_t i = 0; i < _n && bam_cigar_op(_c[i]) == BAM_CSOFT_CLIP; ++i)
+                s += bam_cigar_oplen(_c[i]);
+            return s;
+        }
+
+        uint32_t tail_soft_clip() const {
+            uint32_t s = 0;
+            for (uint32_t i = _n; i > 0 && bam_cigar_op(_c[i - 1]) == BAM_CSOFT_CLIP; --i)
+                s += bam_cigar_oplen(_c[i - 1]);
+            return s;
+        }
+
+        // The bases consumed on the query and on the reference.
+        hts_pos_t query_length() const { return bam_cigar2qlen(_n, _c); }
+        hts_pos_t reference_length() const { return bam_cigar2rlen(_n, _c); }
+
+        // The CIGAR string, e.g. "10S90M", or "*" if it's empty.
+        std::string to_string() const;
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_CIGAR_VIEW_H__
@@ -0,0 +1,200 @@
+// The C++ codes for a columnar batch of BAM records and selection bitmaps
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_COLUMN_BATCH_H__
+#define __INCLUDE_NGSLIB_COLUMN_BATCH_H__
+
+#include <vector>
+#include <stdint.h>
+
+#include <htslib/sam.h>
+#include "ngslib/bam_record.h"
+#include "ngslib/read_filter.h"
+
+namespace ngslib {
+
+    class Bam;
+    class BamIterator;
+
+    /* A bitmap of the records in a ColumnBatch: bit i is set if record i is
+     * selected. Predicates of ColumnBatch make them 64 records per word, and
+     * they are combined by &=, |= and flip(), e.g.
+     *
+     *      batch.select(ReadFilter(BAM_FPAIRED, BAM_FDUP, 20), sel);
+     *      batch.select_tid(0, tmp);
+     *      sel &= tmp;
+     * */
+    class Selection {
+
+    private:
+        std::vector<uint64_t> _bits;  // The bits beyond _n are always 0.
+        size_t _n;
+
+        friend class ColumnBatch;
+
+    public:
+        Selection() : _n(0) {}
+        explicit Selection(size_t n, bool value = false) : _n(0) { resize(n, value); }
+
+        // Keep `n` bits, the new ones are set to `value`.
+        void resize(size_t n, bool value = false);
+
+        size_t size() const { return _n; }
+
+        bool operator[](size_t i) const { return (_bits[i >> 6] >> (i & 63)) & 1; }
+
+        void set(size_t i, bool value = true) {
+            if (value) _bits[i >> 6] |= (uint64_t)1 << (i & 63);
+            else _bits[i >> 6] &= ~((uint64_t)1 << (i & 63));
+        }
+
+        // The number of selected records.
+        size_t count() const;
+
+        // The two bitmaps must be of the same size.
+        Selection &operator&=(const Selection &s);
+        Selection &operator|=(const Selection &s);
+
+        // Select the records which are not selected, and vice versa.
+        void flip();
+
+        // The packed bits, 64 records per word.
+        const uint64_t *data() const { return _bits.empty() ? NULL : &_bits[0]; }
+    };
+
+    // The variable-length data copied into a ColumnBatch besides the columns,
+    // see ColumnBatch::set_payload().
+    struct ColumnPayload {
+        enum {
+            NONE = 0,
+            SEQ = 1,    // The packed bases, as bam_get_seq()
+            QUAL = 2,   // The Phred qualities, as bam_get_qual()
+            AUX = 4,    // The aux tags, as bam_get_aux()
+            ALL = SEQ | QUAL | AUX
+        };
+    };
+
+    // The counts of `samtools flagstat`. The pairing counts are of the
+    // primary reads only (neither secondary nor supplementary).
+    struct FlagStat {
+        uint64_t total;
+        uint64_t qc_fail;
+        uint64_t secondary;
+        uint64_t supplementary;
+        uint64_t duplicates;
+        uint64_t mapped;
+        uint64_t paired;
+        uint64_t read1;
+        uint64_t read2;
+        uint64_t proper_pair;   // Mapped and properly paired
+        uint64_t both_mapped;   // The read and its mate are both mapped
+        uint64_t singletons;    // The read is mapped but its mate is not
+
+        FlagStat() : total(0), qc_fail(0), secondary(0), supplementary(0), duplicates(0), mapped(0),
+                     paired(0), read1(0), read2(0), proper_pair(0), both_mapped(0), singletons(0) {}
+    };
+
+    /* A batch of records stored by columns (struct-of-arrays): one contiguous
+     * array for each of tid, pos, mtid, mpos, isize, flag, mapq and l_qseq.
+     * It is filled by Bam::read_batch() or BamIterator::read_batch().
+     *
+     * QC passes which only look at these fields scan a few small arrays
+     * instead of walking every bam1_t. The predicates (select*()) compare the
+     * columns 2 ~ 16 records at a time by SSE2 where available, and the
+     * statistics work on bitmaps of 64 records: flag_stat() is popcounts of
+     * the FLAG bits, insert_size_hist() only visits the records that count.
+     * The bases, qualities and aux tags are not kept unless they are asked
+     * for by set_payload(), then they are copied into one blob shared by the
+     * batch.
+     *
+     * The arrays are kept across calls, so reading batch after batch into the
+     * same ColumnBatch does no malloc in the steady state.
+     * */
+    class ColumnBatch {
+
+    private:
+        std::vector<int32_t> _tid;
+        std::vector<hts_pos_t> _pos;
+        std::vector<int32_t> _mtid;
+        std::vector<hts_pos_t> _mpos;
+        std::vector<hts_pos_t> _isize;
+        std::vector<uint16_t> _flag;
+        std::vector<uint8_t> _mapq;
+        std::vector<int32_t> _l_qseq;
+
+        int _payload;                 // See ColumnPayload.
+        std::vector<uint8_t> _blob;   // The payload of all the records.
+        std::vector<size_t> _off;     // The payload of record i is [_off[i], _off[i+1]) in _blob.
+
+        BamRecord _br;                // The record read by Bam and BamIterator.
+
+        friend class Bam;
+        friend class BamIterator;
+
+    public:
+        explicit ColumnBatch(int payload = ColumnPayload::NONE) : _payload(payload) { _off.push_back(0); }
+
+        /** Copy the SEQ, QUAL and/or AUX of the records into the batch, see
+         *  ColumnPayload. Call it on an empty batch.
+         */
+        void set_payload(int payload);
+        int payload() const { return _payload; }
+
+        // Pre-allocate the space of `n` records.
+        void reserve(size_t n);
+
+        // Append the core fields (and the payload) of `b`.
+        void append(const bam1_t *b);
+        void append(const BamRecord &br) { append(br.b()); }
+
+        // The number of records in this batch.
+        size_t size() const { return _flag.size(); }
+        bool empty() const { return _flag.empty(); }
+
+        // Forget all the records but keep the memory.
+        void clear();
+
+        /// The columns, `size()` elements each.
+        const int32_t *tid() const { return _tid.data(); }
+        const hts_pos_t *pos() const { return _pos.data(); }
+        const int32_t *mtid() const { return _mtid.data(); }
+        const hts_pos_t *mpos() const { return _mpos.data(); }
+        const hts_pos_t *isize() const { return _isize.data(); }
+        const uint16_t *flag() const { return _flag.data(); }
+        const uint8_t *mapq() const { return _mapq.data(); }
+        const int32_t *l_qseq() const { return _l_qseq.data(); }
+
+        /// The payload of record i, NULL if it's not kept, see set_payload().
+        const uint8_t *seq(size_t i) const;
+        const uint8_t *qual(size_t i) const;
+        const uint8_t *aux(size_t i) const;
+        size_t aux_len(size_t i) const;
+
+        /// Predicates. Each one resizes `sel` to size() and overwrites it.
+
+        // The records passing `filter`: FLAG and MAPQ.
+        void select(const ReadFilter &filter, Selection &sel) const;
+
+        // The records on reference `tid`, with pos in [beg, end) if end > beg.
+        void select_tid(int32_t tid, Selection &sel, hts_pos_t beg = 0, hts_pos_t end = 0) const;
+
+        // The records with min_isize <= |isize| <= max_isize.
+        void select_insert_size(hts_pos_t min_isize, hts_pos_t max_isize, Selection &sel) const;
+
+        /// Statistics of all the records, or of the ones in `sel`. They add
+        /// up the counts, so they could be accumulated batch by batch.
+
+        void flag_stat(FlagStat &st, const Selection *sel = NULL) const;
+
+        /** Count the insert sizes in 1 ~ max_isize of the paired reads with
+         *  isize > 0 (the leftmost read of a pair), into hist[isize].
+         *  `hist` is enlarged to max_isize + 1 if it's smaller.
+         */
+        void insert_size_hist(std::vector<uint64_t> &hist, hts_pos_t max_isize,
+                              const Selection *sel = NULL) const;
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_COLUMN_BATCH_H__
@@ -0,0 +1,120 @@
+// The C++ codes for computing read depth of BAM/CRAM files
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_COVERAGE_H__
+#define __INCLUDE_NGSLIB_COVERAGE_H__
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdint.h>
+
+#include "ngslib/bam.h"
+#include "ngslib/bam_header.h"
+#include "ngslib/read_filter.h"
+#include "ngslib/region.h"
+
+namespace ngslib {
+
+    // The depth summary of a region, e.g. a bin or a BED target.
+    struct CoverageSummary {
+        int tid;
+        hts_pos_t beg;          // 0-based, inclusive
+        hts_pos_t end;          // 0-based, exclusive
+
+        double mean;            // Mean depth
+        uint32_t median;        // Median depth, capped at 65535 for regions > 64kb
+        double frac_min_depth;  // Fraction of positions with depth >= min_depth
+    };
+
+    /* Per-base depth of an indexed BAM/CRAM file, like `samtools depth`.
+     *
+     * Each read adds +1/-1 at the two ends of every aligned block (M, = and X
+     * in CIGAR, deletions and reference skips are not counted) to a difference
+     * array, and the depth is its prefix sum, computed 4 positions at a time
+     * by SSE2 where available. So the cost is per CIGAR block instead of per
+     * base.
+     *
+     * The difference array is a window sliding along the genome: positions
+     * before the start of the current read are final, they are flushed out and
+     * the window moves forward. So the memory of each thread is bounded by the
+     * window size (and the longest aligned block), rather than the length of
+     * chromosomes.
+     *
+     * Reference sequences are counted in parallel, each by one thread with its
+     * own file handle. Results are given by depth callback or summarized by
+     * bins or targets.
+     * */
+    class CoverageCounter {
+
+    public:
+        /** Called with the depth of positions [beg, beg + n) on reference `tid`.
+         *  Chunks of one reference come in order by the same worker, but the
+         *  callback is called concurrently by different workers (0 ~ nthreads-1).
+         */
+        typedef std::function<void(int tid, hts_pos_t beg, const uint32_t *depth, size_t n,
+                                   int worker_id)> DepthCallback;
+
+    private:
+        std::string _fname;
+        int _nthreads;
+        bool _is_cram;
+        Bam _bam;              // Hold the shared index and the header.
+
+        ReadFilter _filter;
+        size_t _window;
+        uint32_t _min_depth;
+
+        // Count the depth in the (merged) regions and pass it to callback.
+        void _run(const std::vector<GenomeRegion> &regions, const DepthCallback &callback);
+
+        // Fill the statistics of `summaries` by counting the depth in regions.
+        void _summarize(std::vector<CoverageSummary> &summaries, const std::vector<GenomeRegion> &regions);
+
+        CoverageCounter(const CoverageCounter &c) = delete;             // reject using copy constructor (C++11 style).
+        CoverageCounter &operator=(const CoverageCounter &c) = delete;  // reject using copy/assignment operator (C++11 style).
+
+    public:
+        /** Create a depth counter for an indexed BAM/CRAM file.
+         *
+         * @param fn        The BAM/CRAM file name
+         * @param nthreads  Number of worker threads, must be > 0. Default: 1
+         *
+         * @exception Throws an invalid_argument if file could not be opened or
+         * the index is not available.
+         */
+        explicit CoverageCounter(const std::string &fn, int nthreads = 1);
+
+        // Reads failing it are not counted.
+        // Default: ReadFilter(0, BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP).
+        void set_filter(const ReadFilter &filter) { _filter = filter; }
+
+        // The size (bp) of sliding window of each thread. Default: 1Mb.
+        void set_window(size_t window);
+
+        // The depth threshold of CoverageSummary::frac_min_depth. Default: 1.
+        void set_min_depth(uint32_t min_depth) { _min_depth = min_depth; }
+
+        BamHeader &header() { return _bam.header(); }
+
+        // Depth of every position of the genome, include the zero ones.
+        void run(const DepthCallback &callback);
+
+        // Depth of every position in regions, overlapped regions are merged.
+        void run(const std::vector<GenomeRegion> &regions, const DepthCallback &callback);
+
+        // Summary of each `bin_size` bp of the genome.
+        std::vector<CoverageSummary> bins(hts_pos_t bin_size);
+
+        // Summary of each target, in the same order as input. Targets could
+        // overlap with each other.
+        std::vector<CoverageSummary> targets(const std::vector<GenomeRegion> &regions);
+
+        // Summary of each target in a BED file, see load_bed().
+        std::vector<CoverageSummary> targets(const std::string &bed_fn);
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_COVERAGE_H__
@@ -0,0 +1,138 @@
+// The C++ codes for marking duplicate reads of a coordinate-sorted BAM/CRAM file
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_DUPLICATE_MARKER_H__
+#define __INCLUDE_NGSLIB_DUPLICATE_MARKER_H__
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "ngslib/bam.h"
+#include "ngslib/bam_header.h"
+
+namespace ngslib {
+
+    struct DuplicateStats {
+        uint64_t n_reads;         // Primary mapped reads examined.
+        uint64_t n_paired;        // Reads with a mapped mate.
+        uint64_t n_duplicates;    // Reads marked as duplicate.
+        uint64_t n_optical;       // Duplicate reads which are optical duplicates.
+
+        DuplicateStats() : n_reads(0), n_paired(0), n_duplicates(0), n_optical(0) {}
+
+        DuplicateStats &operator+=(const DuplicateStats &s) {
+            n_reads += s.n_reads;
+            n_paired += s.n_paired;
+            n_duplicates += s.n_duplicates;
+            n_optical += s.n_optical;
+            return *this;
+        }
+
+        friend std::ostream &operator<<(std::ostream &os, const DuplicateStats &s);
+    };
+
+    /* Mark the duplicate reads of an indexed, coordinate-sorted BAM/CRAM file
+     * and write a BAM file, like `samtools markdup` or Picard MarkDuplicates.
+     *
+     * Reads are grouped by the unclipped 5' ends (reference, position and
+     * strand) of the read and of its mate, plus the UMI if a UMI tag is set.
+     * In each group, the template with the highest sum of base qualities
+     * (>= 15) is kept and the others are duplicates. A single read (unpaired
+     * or mate unmapped) is a duplicate if any pair ends at the same place.
+     *
+     * The end of mate is taken from the MC tag and its score from the ms tag,
+     * as `samtools fixmate -m` adds. Without MC, the leftmost (clipped)
+     * positions of both reads are used instead. Both reads of a pair see the
+     * same group with the same scores at their own ends, so they come to the
+     * same decision independently: no read waits for its mate, and each
+     * reference is processed by a thread of its own. Records are buffered only
+     * until the groups at their 5' ends are closed, the groups hold compact
+     * signatures rather than records.
+     *
+     * Each worker writes the references it takes to a part of BGZF blocks
+     * next to the output file. For BAM output, the parts are joined in order
+     * by bytes at the end, so the output is compressed in parallel and no
+     * record is compressed twice. That's also why it's not written by
+     * BamWriter, and it's indexed by Bam::index_build() afterwards if
+     * set_index(). CRAM could not be joined like that: the parts are written
+     * with fast compression, then re-encoded in order by BamWriter, which
+     * indexes the output on the fly.
+     *
+     * Secondary and supplementary records are not marked, all the read
+     * groups are treated as one library. The existing duplicate flags are
+     * cleared first.
+     * */
+    class DuplicateMarker {
+
+    private:
+        std::string _fname;
+        int _nthreads;
+        bool _is_cram;
+        Bam _bam;                // Hold the shared index and the header.
+
+        std::string _umi_tag;
+        int _optical_distance;
+        bool _remove;
+        int _compress_level;
+        std::string _reference;
+        bool _index;
+        int _min_shift;
+
+        DuplicateMarker(const DuplicateMarker &m) = delete;             // reject using copy constructor (C++11 style).
+        DuplicateMarker &operator=(const DuplicateMarker &m) = delete;  // reject using copy/assignment operator (C++11 style).
+
+    public:
+        /** Create a duplicate marker for an indexed BAM/CRAM file.
+         *
+         * @param fn        The BAM/CRAM file name, sorted by coordinate.
+         * @param nthreads  Number of worker threads, must be > 0. Default: 1
+         *
+         * @exception Throws an invalid_argument if file could not be opened or
+         * the index is not available.
+         */
+        explicit DuplicateMarker(const std::string &fn, int nthreads = 1);
+
+        // Group reads by the UMI in this tag too, e.g. "RX". Default: "", no UMI.
+        void set_umi_tag(const std::string &tag);
+
+        /** Duplicates within `distance` pixels of another read of the group on
+         *  the same tile are counted as optical duplicates and tagged with
+         *  dt:Z:SQ. The tile and coordinates are read from the last 3 fields of
+         *  Illumina read names. Default: 0, not checked.
+         */
+        void set_optical_distance(int distance) { _optical_distance = distance; }
+
+        // Remove the duplicates instead of marking them. Default: false.
+        void set_remove(bool remove) { _remove = remove; }
+
+        // The compression level (0-9) of BAM output, -1 for the default.
+        void set_compress_level(int level) { _compress_level = level; }
+
+        // The FASTA reference for CRAM output.
+        void set_reference(const std::string &fa) { _reference = fa; }
+
+        /** Index the output, `min_shift` > 0 for CSI instead of BAI, see
+         *  BamWriter::set_index(). CRAM is always indexed by CRAI.
+         */
+        void set_index(bool index, int min_shift = 0) { _index = index; _min_shift = min_shift; }
+
+        BamHeader &header() { return _bam.header(); }
+
+        /** Mark the duplicates and write all the records to `out_fn`, in the
+         *  same order as input.
+         *
+         * @param out_fn  The output file
+         * @param mode    "wb" for BAM (default), "wc" for CRAM, see BamWriter.
+         *
+         * @exception Throws an invalid_argument if the input is not sorted or
+         * any file fails, and rethrows the first exception of workers.
+         */
+        DuplicateStats run(const std::string &out_fn, const std::string &mode = "wb");
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_DUPLICATE_MARKER_H__
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <utility>
 
 #include <htslib/faidx.h>
 
@@ -35,7 +36,17 @@ namespace ngslib {
 
         Fasta(const std::string &file_name) { this->_load_data(file_name.c_str()); }
 
-        Fasta(const Fasta &);  // copy constructor
+        Fasta(const Fasta &);  // copy constructor, the FASTA index is loaded again.
+
+        // Move constructor and assignment, take over the index and the cached
+        // sequences of `fa` and leave it empty.
+        Fasta(Fasta &&fa) noexcept : fname(std::move(fa.fname)), fai(fa.fai), _seq(std::move(fa._seq)) {
+            fa.fai = NULL;
+        }
+        Fasta &operator=(Fasta &&fa) noexcept;
+
+        // An explicit deep copy.
+        Fasta clone() const { return Fasta(*this); }
 
         // Destroy the malloc'ed faidx_t index inside object
         ~Fasta() { if (fai) fai_destroy(fai); }
@@ -43,7 +54,10 @@ namespace ngslib {
         Fasta &operator=(const char *s);
 
         Fasta &operator=(const std::string &s) { return *this = s.c_str(); }  // inline definition
-        Fasta &operator=(const Fasta &s) { return *this = s.fname; }  // inline definition
+        Fasta &operator=(const Fasta &s) {  // inline definition
+            if (this != &s) *this = s.fname;
+            return *this;
+        }
 
         // Return the sequence string of seq_id
         std::string &operator[](std::string seq_id);
@@ -0,0 +1,104 @@
+// The C++ codes for sharing loaded BAM indexes in one process
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_INDEX_CACHE_H__
+#define __INCLUDE_NGSLIB_INDEX_CACHE_H__
+
+#include <ctime>
+#include <string>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <htslib/hts.h>
+
+namespace ngslib {
+
+    // A loaded index shared by many Bam/BamIterator objects and threads. It
+    // must be treated as read-only, and is destroyed after the last user and
+    // the cache have released it.
+    typedef std::shared_ptr<hts_idx_t> SharedIndex;
+
+    /* A process-wide cache of BAI/CSI indexes.
+     *
+     * Indexes are keyed by the path of data file plus the modification time of
+     * data and index files, so a rewritten file is re-loaded. The memory of all
+     * cached indexes is bounded by a budget (default: 1GB). The least recently
+     * used indexes are evicted once the budget is exceeded, but only those not
+     * being used by anyone, evicting an index in use saves no memory.
+     *
+     * Note: a CRAM index (.crai) is bound to the file handle which loaded it in
+     * htslib, so it's not shareable and never cached.
+     * */
+    class IndexCache {
+
+    private:
+        struct Entry {
+            SharedIndex idx;
+            std::string fnidx;   // The path of index file
+            time_t mtime;        // The latest modification time of data and index files
+            size_t bytes;        // Estimated memory used by the index
+            uint64_t last_use;   // Tick of the last time it was hit
+        };
+
+        std::map<std::string, Entry> _entries;  // Keyed by data file path.
+        mutable std::mutex _lock;               // Guards all the members below, not held by loading.
+
+        size_t _budget;    // Memory budget in bytes
+        size_t _bytes;     // Memory used by all cached indexes
+        uint64_t _tick;    // A logical clock for LRU
+
+        size_t _hit, _miss;
+
+        IndexCache() : _budget(size_t(1) << 30), _bytes(0), _tick(0), _hit(0), _miss(0) {}
+
+        // Evict the least recently used indexes not in use until within budget.
+        void _evict();
+
+        IndexCache(const IndexCache &ic) = delete;             // reject using copy constructor (C++11 style).
+        IndexCache &operator=(const IndexCache &ic) = delete;  // reject using copy/assignment operator (C++11 style).
+
+    public:
+        // The only one cache in the process.
+        static IndexCache &instance();
+
+        /** Get the BAI/CSI index of a BAM (or bgzip compressed SAM) file,
+         *  load it if it's not in the cache or the file has been changed.
+         *  Indexes are loaded outside the lock, so loading different files
+         *  in threads does not wait for each other. If two threads load the
+         *  same file at once, the first one cached is used by both.
+         *
+         * @param fn  The data file name, index is searched as fn.csi, fn.bai or
+         *            the .bai replacing the extension of fn.
+         * @return the shared index.
+         *
+         * @exception Throws an invalid_argument if the index is not available.
+         */
+        SharedIndex load(const std::string &fn);
+
+        // Set the memory budget in bytes, and evict indexes if necessary.
+        void set_budget(size_t bytes);
+
+        size_t budget() const { std::lock_guard<std::mutex> guard(_lock); return _budget; }
+
+        // Estimated memory used by all cached indexes. It's the size of index
+        // files on disk, CSI files are compressed so scaled by 3.
+        size_t bytes() const { std::lock_guard<std::mutex> guard(_lock); return _bytes; }
+
+        // The number of cached indexes.
+        size_t size() const { std::lock_guard<std::mutex> guard(_lock); return _entries.size(); }
+
+        size_t hit() const { std::lock_guard<std::mutex> guard(_lock); return _hit; }
+        size_t miss() const { std::lock_guard<std::mutex> guard(_lock); return _miss; }
+
+        // Drop the index of `fn` from cache, e.g. it has been rebuilt.
+        void drop(const std::string &fn);
+
+        // Drop all the indexes from cache, those in use are kept alive by users.
+        void clear();
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_INDEX_CACHE_H__
@@ -0,0 +1,77 @@
+// The C++ codes for the statistics of reads kept in BAI/CSI index
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_INDEX_STATS_H__
+#define __INCLUDE_NGSLIB_INDEX_STATS_H__
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include <htslib/hts.h>
+#include "ngslib/bam_header.h"
+#include "ngslib/region.h"
+
+namespace ngslib {
+
+    // The read counts and data size of one reference sequence. -1 if unknown.
+    struct ContigStats {
+        int tid;
+        std::string name;
+        hts_pos_t length;
+
+        int64_t mapped;     // The number of mapped reads
+        int64_t unmapped;   // The number of unmapped reads placed on this sequence
+
+        // Estimated compressed bytes of the reads on this sequence, from the
+        // BGZF offsets of index chunks.
+        int64_t bytes;
+    };
+
+    struct IndexStats {
+        std::vector<ContigStats> contigs;  // In the order of header
+        int64_t n_no_coor;                 // Unmapped reads without coordinate, -1 if unknown.
+
+        /* Output as `samtools idxstats`: name, length, mapped and unmapped reads,
+         * one sequence per line, and the no-coordinate reads at the last line. */
+        friend std::ostream &operator<<(std::ostream &os, const IndexStats &s);
+    };
+
+    /** Collect the statistics of every reference sequence from an index, no
+     *  read is scanned. The counts are only kept in BAI/CSI, so they are -1 for
+     *  CRAM index (CRAI), as well as the bytes. They are -1 too if a sequence
+     *  has reads in the index but no counts (an index without the meta
+     *  pseudo-bin), which is not the same as 0: a sequence without any read.
+     *
+     * @param idx  The index of file
+     * @param hdr  The header of file
+     */
+    IndexStats index_stats(hts_idx_t *idx, const BamHeader &hdr);
+
+    /** Split the reference sequences into `n_shards` shards of about the same
+     *  compressed bytes, estimated from the BGZF offsets in BAI/CSI index. So a
+     *  deep region gets short shards and an empty one gets long shards, while
+     *  split_genome() cuts them by length.
+     *
+     *  Shards tile every sequence which has reads: one starts where the last
+     *  one ends, and the sequences without any read are skipped. CRAI keeps no
+     *  offset of reads, the shards are cut by length then.
+     *
+     * @param idx         The index of file
+     * @param hdr         The header of file
+     * @param n_shards    The number of shards wanted, the result may be a few
+     *                    more as a shard never crosses two sequences.
+     * @param resolution  The bytes are estimated by windows of this size (bp),
+     *                    a boundary of shard is always on a window boundary.
+     *                    Default: 1Mb
+     *
+     * @exception Throws an invalid_argument if n_shards or resolution <= 0.
+     */
+    std::vector<GenomeRegion> split_genome_by_bytes(hts_idx_t *idx, const BamHeader &hdr, size_t n_shards,
+                                                    hts_pos_t resolution = 1000000);
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_INDEX_STATS_H__
@@ -0,0 +1,62 @@
+// The C++ codes for running jobs in worker threads
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_JOB_RUNNER_H__
+#define __INCLUDE_NGSLIB_JOB_RUNNER_H__
+
+#include <atomic>
+#include <functional>
+
+namespace ngslib {
+
+    /* The fan-out of worker threads shared by BamScanner, CoverageCounter and
+     * DuplicateMarker, e.g.
+     *
+     *      JobRunner runner(jobs.size());
+     *      runner.run(nthreads, [&](int worker_id) {
+     *          Bam bam(fn, "r");  // Private state of the worker
+     *          size_t j;
+     *          while (runner.next_job(j)) { ... jobs[j] ... }
+     *      });
+     *
+     * The first exception thrown by a worker aborts the others: next_job()
+     * returns false and aborted() true from then on. It's rethrown by run()
+     * after all the workers have been joined.
+     * */
+    class JobRunner {
+
+    private:
+        std::atomic<size_t> _next;
+        size_t _n_jobs;
+        std::atomic<bool> _abort;
+
+        JobRunner(const JobRunner &) = delete;             // reject using copy constructor (C++11 style).
+        JobRunner &operator=(const JobRunner &) = delete;  // reject using copy/assignment operator (C++11 style).
+
+    public:
+        // `n_jobs` jobs handed out by next_job(), 0 if the workers take their
+        // jobs in their own way.
+        explicit JobRunner(size_t n_jobs = 0) : _next(0), _n_jobs(n_jobs), _abort(false) {}
+
+        // Take the next job 0 ~ n_jobs-1 in order, false if none is left or aborted.
+        bool next_job(size_t &j) {
+            if (_abort) return false;
+            j = _next++;
+            return j < _n_jobs;
+        }
+
+        // A worker has failed, the others should stop as soon as possible.
+        bool aborted() const { return _abort; }
+
+        /** Call `worker(worker_id)` (worker_id: 0 ~ n_worker-1) in `n_worker`
+         *  threads and wait for all of them.
+         *
+         * @exception Rethrows the exception of a failed worker.
+         */
+        void run(size_t n_worker, const std::function<void(int worker_id)> &worker);
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_JOB_RUNNER_H__
@@ -0,0 +1,214 @@
+// The C++ codes for pairing up the mates in a coordinate-sorted stream
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_MATE_PAIRER_H__
+#define __INCLUDE_NGSLIB_MATE_PAIRER_H__
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <functional>
+#include <stdint.h>
+
+#include <htslib/sam.h>
+#include <htslib/bgzf.h>
+#include "ngslib/bam_record.h"
+
+namespace ngslib {
+
+    /* Pair up the two records of each template in a coordinate-sorted stream,
+     * from a Bam, a BamIterator, MultiBam or anything with
+     * `int next(BamRecord &br)`:
+     *
+     *      MatePairer mp;
+     *      BamRecord r1, r2;
+     *      bam.fetch("chr1");
+     *      while (mp.next(bam, r1, r2) >= 0) {
+     *          ...  // r1 is READ1 and r2 is READ2 of one template
+     *      }
+     *
+     * A pair is given as soon as the second mate is seen. The first one waits
+     * in an open-addressing hash table keyed by qname, until its mate comes or
+     * the stream passes the position of its mate (which means the mate is not
+     * in the stream, an orphan).
+     *
+     * Memory is capped: a record is spilled to a temporary file instead if its
+     * mate is more than `max_distance` bp away or on another reference, or the
+     * table already holds `max_pending` records; its mate then goes to the
+     * same file as it finds nothing in the table. Records are spilled to
+     * `n_partitions` files by the hash of qname, which are paired one by one
+     * at the end of stream, so a partition has to fit in memory.
+     *
+     * Only the primary records of paired reads are paired, the secondary,
+     * supplementary and unpaired ones are skipped.
+     * */
+    class MatePairer {
+
+    private:
+        // A record waiting for its mate.
+        struct _Pending {
+            bam1_t *b;     // NULL if the slot is free.
+            int fields;
+            uint64_t hash;
+            uint32_t gen;  // Increased every time the slot is reused.
+        };
+
+        // Where a waiting record gives up: when the stream passes (tid, pos).
+        struct _Deadline {
+            uint32_t tid;  // unsigned, so the unmapped (-1) is the last.
+            hts_pos_t pos;
+            uint32_t idx;
+            uint32_t gen;
+
+            bool operator>(const _Deadline &d) const {
+                return tid != d.tid ? tid > d.tid : pos > d.pos;
+            }
+        };
+
+        struct _Pair {
+            bam1_t *b1, *b2;
+            int f1, f2;
+        };
+
+        size_t _max_pending;
+        hts_pos_t _max_distance;
+        size_t _n_partitions;
+        std::string _tmp_dir;
+
+        // Open-addressing table with linear probing, _slots[i] is the index
+        // of _pool + 1, 0 for an empty slot.
+        std::vector<uint32_t> _slots;
+        std::vector<uint64_t> _hashes;
+        size_t _n_pending;
+
+        std::vector<_Pending> _pool;
+        std::vector<uint32_t> _free;    // Free indexes of _pool.
+        std::vector<bam1_t *> _spare;   // Free records to reuse.
+
+        std::priority_queue<_Deadline, std::vector<_Deadline>, std::greater<_Deadline> > _deadlines;
+        std::deque<_Pair> _ready;
+
+        // The spill files, opened at the first spilled record.
+        std::vector<int> _spill_fd;
+        std::vector<BGZF *> _spill;
+        int _spill_fields;
+        size_t _next_partition;        // The next partition to pair at the end.
+
+        uint32_t _last_tid;
+        hts_pos_t _last_pos;
+        // Mates at the same position come in any order. Once a record is
+        // spilled here as the table is full, the later ones at this position
+        // finding no mate are spilled too, rather than waiting for nothing.
+        uint32_t _full_tid;
+        hts_pos_t _full_pos;
+        bool _finished;
+
+        uint64_t _n_pairs, _n_orphans, _n_spilled, _n_skipped;
+
+        // The record reused by next().
+        BamRecord _br;
+
+        static uint64_t _hash(const bam1_t *b);
+
+        bam1_t *_new_record();
+        void _recycle(bam1_t *b);
+
+        // Return the slot of the mate of `b` in the table, or -1 if not found.
+        long _find(const bam1_t *b, uint64_t h) const;
+        // Return the slot of _pool[idx] in the table.
+        size_t _slot_of(uint32_t idx) const;
+        void _erase(size_t slot);
+        void _grow();
+
+        // Keep `b` waiting in the table, return its index in _pool.
+        uint32_t _wait(bam1_t *b, int fields, uint64_t h);
+        // Pair `b` with the record in slot, which is removed from the table.
+        void _make_pair(size_t slot, bam1_t *b, int fields);
+        // Remove the record in slot from the table as an orphan.
+        void _drop(size_t slot);
+        // Remove all the records from the table, count them as orphans or not.
+        void _clear_table(bool orphan);
+
+        void _open_spill();
+        void _spill_record(bam1_t *b, int fields, uint64_t h);
+        void _close_spill();
+
+        // Pair the records of the next partition of spill files.
+        int _pair_partition();
+
+        MatePairer(const MatePairer &m) = delete;             // reject using copy constructor (C++11 style).
+        MatePairer &operator=(const MatePairer &m) = delete;  // reject using copy/assignment operator (C++11 style).
+
+    public:
+        /**
+         * @param max_pending   The max number of records waiting in memory.
+         *                      Default: 1000000
+         * @param max_distance  Records with mate further than this (bp) are
+         *                      spilled. Default: 10000
+         */
+        explicit MatePairer(size_t max_pending = 1000000, hts_pos_t max_distance = 10000);
+        ~MatePairer();
+
+        // The directory of spill files. Default: $TMPDIR or /tmp.
+        void set_tmp_dir(const std::string &dir) { _tmp_dir = dir; }
+
+        // The number of spill files, call it before the first record. Default: 16.
+        void set_partitions(size_t n);
+
+        /** Feed the next record of a coordinate-sorted stream. The bam1_t of
+         *  `br` is taken without copying, and `br` gets a recycled one.
+         *
+         * @exception Throws an invalid_argument if the stream is not sorted by
+         * coordinate, it's called after finish() or a spill file fails.
+         */
+        void push(BamRecord &br);
+
+        // The end of stream, the records in spill files are paired by pop().
+        void finish();
+
+        /** Take a pair, `read1` is the READ1 (or the first one in stream if
+         *  flags do not tell).
+         *
+         * @return 0 on success, -1 if no pair is ready (or no more pair after
+         * finish()), < -1 on error of reading spill files.
+         */
+        int pop(BamRecord &read1, BamRecord &read2);
+
+        /** Read `reader` until a pair is ready, and finish() at the end of it.
+         *
+         * @return 0 on success, -1 if there is no more pair, < -1 on error.
+         */
+        template<typename Reader>
+        int next(Reader &reader, BamRecord &read1, BamRecord &read2) {
+
+            int ret;
+            while ((ret = pop(read1, read2)) == -1 && !_finished) {
+                int io_status = reader.next(_br);
+                if (io_status < -1) return io_status;
+
+                if (io_status < 0) {
+                    finish();
+                } else {
+                    push(_br);
+                }
+            }
+
+            return ret;
+        }
+
+        // Drop everything and start over for a new stream.
+        void reset();
+
+        size_t n_pending() const { return _n_pending; }
+
+        uint64_t n_pairs() const { return _n_pairs; }      // Pairs given out.
+        uint64_t n_orphans() const { return _n_orphans; }  // Records whose mate never came.
+        uint64_t n_spilled() const { return _n_spilled; }  // Records spilled to files.
+        uint64_t n_skipped() const { return _n_skipped; }  // Secondary, supplementary or unpaired.
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_MATE_PAIRER_H__
@@ -0,0 +1,173 @@
+// The C++ codes for merging many coordinate-sorted BAM/CRAM files
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_MULTI_BAM_H__
+#define __INCLUDE_NGSLIB_MULTI_BAM_H__
+
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "ngslib/bam.h"
+#include "ngslib/bam_header.h"
+#include "ngslib/bam_sort.h"
+#include "ngslib/bam_record.h"
+#include "ngslib/record_batch.h"
+#include "ngslib/record_iterator.h"
+
+namespace ngslib {
+
+    /* Read many coordinate-sorted SAM/BAM/CRAM files as one stream in genome
+     * order, e.g. walking hundreds of per-sample BAMs together.
+     *
+     * The head records of all the inputs are merged by a loser tree, so each
+     * record costs log2(k) comparisons for k inputs. Records are ordered by
+     * (tid, pos, strand) as `samtools sort` does, unmapped reads without
+     * coordinate are at the end, and ties are broken by the index of input,
+     * so the merge is stable. source() tells which input the last record came
+     * from. Files sorted by read name could be merged by set_order().
+     *
+     * All the inputs must have the same reference dictionary (names and
+     * lengths of @SQ, in the same order) as the first one, otherwise an
+     * invalid_argument is thrown when the mismatched file is opened.
+     *
+     * Nothing is opened until the first record is read. With `max_open` > 0,
+     * at most `max_open` files are kept open: the least recently used BAM is
+     * closed after buffering its next records, and resumed later by seeking
+     * to the BGZF virtual offset it has reached. CRAM/SAM inputs could not be
+     * resumed like that and are always kept open until they are exhausted.
+     * */
+    class MultiBam {
+
+    private:
+        struct _Source {
+            std::string fname;
+            std::unique_ptr<Bam> bam;  // NULL if not opened yet, closed or exhausted.
+            hts_itr_t *itr;            // The iterator of a closed BAM to resume.
+            int64_t offset;            // The virtual offset to resume a closed BAM, -1 if none.
+            bool checked;              // The header has been checked.
+            bool eof;                  // No more record in the file.
+
+            RecordBatch buffer;        // Records read ahead, [next, buffer.size()) are not used.
+            size_t next;
+            unsigned long last_use;
+
+            explicit _Source(const std::string &fn) : fname(fn), itr(NULL), offset(-1), checked(false),
+                                                      eof(false), next(0), last_use(0) {}
+            ~_Source() { if (itr) sam_itr_destroy(itr); }
+
+            bool exhausted() const { return eof && next >= buffer.size(); }
+        };
+
+        std::vector<std::unique_ptr<_Source> > _sources;
+        std::vector<size_t> _tree;  // Loser tree, _tree[0] is the winner.
+
+        BamHeader _hdr;             // The header of the first input.
+        std::string _region;        // Only read records in this region if not empty.
+
+        size_t _max_open;           // The max number of files kept open, 0 for no limit.
+        size_t _buffer_size;        // The number of records read ahead for each input.
+        size_t _n_open;
+        unsigned long _tick;
+
+        int _order;                 // SortOrder of the inputs.
+        SharedThreadPool _tpool;    // Shared by all the inputs if it's not NULL.
+
+        bool _started;              // The loser tree has been built.
+        size_t _source;             // The input of the last record.
+        int _io_status;
+
+        // The record reused by begin()/end() iteration.
+        BamRecord _iter_br;
+
+        // Compare the head records, true if source `a` goes before source `b`.
+        bool _before(size_t a, size_t b) const;
+
+        // Replay the matches of source `s` from its leaf to the root.
+        void _adjust(size_t s);
+
+        // Make sure source `i` has a head record unless it's exhausted.
+        int _fill(size_t i);
+
+        void _open(size_t i);
+        void _close_lru(size_t keep);
+        void _check_header(size_t i);
+        void _start();
+
+        MultiBam(const MultiBam &mb) = delete;             // reject using copy constructor (C++11 style).
+        MultiBam &operator=(const MultiBam &mb) = delete;  // reject using copy/assignment operator (C++11 style).
+
+    public:
+        /** Merge the files in `fns`.
+         *
+         * @param fns          SAM/BAM/CRAM files, all sorted by coordinate
+         * @param max_open     The max number of files kept open. Default: 0, no limit.
+         * @param buffer_size  The number of records read ahead from each file
+         *                     every time, a larger one means fewer re-opening
+         *                     when `max_open` is small. Default: 64.
+         *
+         * @exception Throws an invalid_argument if `fns` is empty.
+         */
+        explicit MultiBam(const std::vector<std::string> &fns, size_t max_open = 0, size_t buffer_size = 64);
+
+        ~MultiBam() {}
+
+        /** The order of inputs, SortOrder::COORDINATE (default) or
+         *  SortOrder::QUERYNAME. Call it before reading any record.
+         *
+         * @exception Throws an invalid_argument if order is unknown or it's
+         * called too late.
+         */
+        void set_order(int order);
+
+        // Decompress all the inputs with this (shared) thread pool.
+        void set_thread_pool(const SharedThreadPool &tp) { _tpool = tp; }
+
+        // The number of input files.
+        size_t size() const { return _sources.size(); }
+
+        const std::string &fname(size_t i) const { return _sources[i]->fname; }
+
+        // The number of files opening now.
+        size_t n_open() const { return _n_open; }
+
+        // The header of the first file, shared by all the files.
+        BamHeader &header();
+
+        /** Only merge the records in `region` of every file, all of them must be
+         *  indexed. See Bam::fetch() for the format of region. Reading starts over
+         *  from the beginning of region.
+         *
+         *  @return this MultiBam, which could be iterated by range-for.
+         */
+        MultiBam &fetch(const std::string &region);
+
+        /// Read the next record in coordinate (or the order set by set_order()) order.
+        /** @return >= 0 on successfully reading a new record, -1 after all the
+         *          files end, < -1 on error.
+         *
+         *  @exception Throws an invalid_argument if a file could not be opened, its
+         *  reference dictionary is different from the first one, or it's found
+         *  not sorted.
+         **/
+        int read(BamRecord &br);
+
+        int next(BamRecord &br) { return read(br); }
+
+        // The index of file the last record read from.
+        size_t source() const { return _source; }
+
+        typedef RecordInputIterator<MultiBam> iterator;
+
+        iterator begin() { return iterator(this, &_iter_br); }
+        iterator end() { return iterator(); }
+
+        int io_status() const { return _io_status; }
+
+        operator bool() const { return _io_status >= 0; }
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_MULTI_BAM_H__
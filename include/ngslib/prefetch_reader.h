@@ -0,0 +1,93 @@
+// The C++ codes for reading BAM/CRAM records ahead in a background thread
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_PREFETCH_READER_H__
+#define __INCLUDE_NGSLIB_PREFETCH_READER_H__
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include <htslib/sam.h>
+#include "ngslib/bam_record.h"
+
+namespace ngslib {
+
+    /* Read records ahead of the consumer.
+     *
+     * A background producer decodes records from the file (or an iterator) into
+     * a bounded ring of bam1_t, and the consumer takes them by next() in the
+     * same order. The ring is single-producer/single-consumer and lock-free:
+     * each side only moves its own counter (_tail by producer and _head by
+     * consumer), so no mutex is taken for each record. A record is handed over
+     * by exchanging the bam1_t pointers of the slot and the BamRecord, no copy.
+     *
+     * The status of the last read (-1 at the end of stream, < -1 on error) is
+     * passed through the ring too, so the consumer sees exactly what
+     * sam_read1()/sam_itr_next() returned.
+     *
+     * This class is used by Bam::set_prefetch(), the file must not be touched by
+     * others between start() and stop().
+     * */
+    class PrefetchReader {
+
+    private:
+        struct Slot {
+            bam1_t *b;
+            int status;
+        };
+
+        std::vector<Slot> _ring;
+        std::atomic<size_t> _head;  // The next slot to consume, moved by consumer only
+        std::atomic<size_t> _tail;  // The next slot to fill, moved by producer only
+        std::atomic<bool> _stop;
+
+        samFile *_fp;
+        sam_hdr_t *_hdr;
+        hts_itr_t *_itr;
+        ReadFilter _filter;  // Records failing it are skipped by the producer.
+
+        std::thread _producer;
+        bool _running;     // The producer has been started and not stopped
+        int _end_status;   // The terminal status (< 0) consumed, 0 if not yet.
+
+        void _produce();
+
+        PrefetchReader(const PrefetchReader &pr) = delete;             // reject using copy constructor (C++11 style).
+        PrefetchReader &operator=(const PrefetchReader &pr) = delete;  // reject using copy/assignment operator (C++11 style).
+
+    public:
+        // @param depth  The max number of records read ahead, must be > 0.
+        explicit PrefetchReader(size_t depth);
+        ~PrefetchReader();
+
+        /** Start reading ahead.
+         *
+         * @param fp   samFile pointer to the source file
+         * @param hdr  The header of file
+         * @param itr  Read by this iterator if it's not NULL, otherwise read
+         *             the file sequentially.
+         * @param filter  Skip the records failing it in the background thread.
+         */
+        void start(samFile *fp, sam_hdr_t *hdr, hts_itr_t *itr, const ReadFilter &filter = ReadFilter());
+
+        // Stop the producer and drop all the records read ahead.
+        void stop();
+
+        bool running() const { return _running; }
+
+        size_t depth() const { return _ring.size(); }
+
+        /** Take the next record.
+         *
+         * @param fields  The fields decoded by the file, see Bam::set_fields().
+         * @return >= 0 on success, -1 on end of stream, < -1 on error, as
+         *         sam_read1()/sam_itr_next() do.
+         */
+        int next(BamRecord &br, int fields = Fields::ALL);
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_PREFETCH_READER_H__
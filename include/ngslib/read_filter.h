@@ -0,0 +1,42 @@
+// The C++ codes for filtering alignment records while reading
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_READ_FILTER_H__
+#define __INCLUDE_NGSLIB_READ_FILTER_H__
+
+#include <stdint.h>
+#include <htslib/sam.h>
+
+namespace ngslib {
+
+    /* A compiled filter by FLAG and MAPQ, the same as `samtools view -f -F -q`.
+     *
+     * It's checked on the raw bam1_t inside the read loop of Bam/BamIterator,
+     * so the rejected records never become a BamRecord and never go back to
+     * the caller. e.g. skip the duplicates,
+     * secondary, supplementary and QC failed reads with MAPQ < 20:
+     *
+     *      bam.set_filter(ReadFilter(0, BAM_FDUP | BAM_FSECONDARY | BAM_FSUPPLEMENTARY | BAM_FQCFAIL, 20));
+     * */
+    struct ReadFilter {
+        uint16_t require_flags;  // Records must have all of these flags
+        uint16_t exclude_flags;  // Records must have none of these flags
+        int min_mapq;            // Records must have MAPQ >= min_mapq
+
+        explicit ReadFilter(uint16_t require = 0, uint16_t exclude = 0, int min_mapq = 0) :
+                require_flags(require), exclude_flags(exclude), min_mapq(min_mapq) {}
+
+        // Nothing to be filtered.
+        bool empty() const { return require_flags == 0 && exclude_flags == 0 && min_mapq <= 0; }
+
+        bool pass(const bam1_t *b) const {
+            return ((b->core.flag & require_flags) == require_flags) &&
+                   ((b->core.flag & exclude_flags) == 0) &&
+                   (b->core.qual >= min_mapq);
+        }
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_READ_FILTER_H__
@@ -0,0 +1,104 @@
+// The C++ codes for packing many BAM records into a few large blocks of memory
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_RECORD_ARENA_H__
+#define __INCLUDE_NGSLIB_RECORD_ARENA_H__
+
+#include <vector>
+#include <stdint.h>
+
+#include <htslib/sam.h>
+#include "ngslib/bam_record.h"
+
+namespace ngslib {
+
+    /* An arena of BAM records for holding many of them in memory at once, e.g.
+     * a sorting or a pileup window.
+     *
+     * Each record is copied into a slab: its bam1_t and then its data, packed
+     * next to each other. So there is one malloc per slab (of `slab_size`
+     * bytes, 4MB by default) instead of two per record, and all the records are
+     * freed together by release() or by the destructor. A record larger than a
+     * slab gets a slab of its own.
+     *
+     * The copies are marked as owned by the user (BAM_USER_OWNS_STRUCT |
+     * BAM_USER_OWNS_DATA, see bam_set_mempolicy()), so bam_destroy1() leaves
+     * them alone, and the BamRecord handles returned by record() can be passed
+     * around and destroyed as usual. They must not outlive the arena or the
+     * next clear(), and should be read only: a copy of them (BamRecord's copy
+     * constructor, clone()) is an ordinary record on the heap.
+     * */
+    class RecordArena {
+
+    private:
+        struct _Slab {
+            uint8_t *mem;
+            size_t size;
+        };
+
+        struct _Entry {
+            bam1_t *b;
+            int fields;   // The fields decoded in b, see Fields.
+        };
+
+        std::vector<_Slab> _slabs;     // Never shrink until release().
+        std::vector<_Entry> _records;
+        size_t _slab_size;
+        size_t _cur;                   // The slab in use.
+        size_t _off;                   // The first free byte of _slabs[_cur].
+        size_t _bytes_used;
+
+        // Return `n` bytes aligned to 8 in a slab, move on to the next slab
+        // (or allocate one) if the current one is full.
+        uint8_t *_alloc(size_t n);
+
+    public:
+        explicit RecordArena(size_t slab_size = 4 << 20);
+        ~RecordArena() { release(); }
+
+        RecordArena(const RecordArena &) = delete;  // reject using copy constructor (C++11 style).
+        RecordArena &operator=(const RecordArena &) = delete;
+
+        /** Copy `b` into the arena.
+         *
+         * @param b       The record to copy, it's not changed.
+         * @param fields  The fields decoded in `b`, see Fields.
+         * @return The copy, valid until clear() or the arena is destroyed.
+         */
+        bam1_t *add(const bam1_t *b, int fields = Fields::ALL);
+        bam1_t *add(const BamRecord &br) { return add(br.b(), br.fields()); }
+
+        // The number of records in the arena.
+        size_t size() const { return _records.size(); }
+        bool empty() const { return _records.empty(); }
+
+        // The i-th record in the order they were added.
+        bam1_t *operator[](size_t i) const { return _records[i].b; }
+
+        /** A BamRecord handle of the i-th record, nothing is copied. All the
+         *  BamRecord accessors work on it, but see the notes above for how
+         *  long it's valid.
+         */
+        BamRecord record(size_t i) const;
+
+        // Forget all the records, but keep the slabs to reuse them.
+        void clear();
+
+        // Free all the records and slabs.
+        void release();
+
+        /// The memory footprint, in bytes.
+
+        // The memory taken by the records, including the alignment padding.
+        size_t bytes_used() const { return _bytes_used; }
+
+        // All the memory held by the arena: the slabs and the table of records.
+        size_t bytes_allocated() const;
+
+        size_t n_slabs() const { return _slabs.size(); }
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_RECORD_ARENA_H__
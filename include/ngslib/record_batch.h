@@ -0,0 +1,61 @@
+// The C++ codes for a reusable batch of BAM records
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_RECORD_BATCH_H__
+#define __INCLUDE_NGSLIB_RECORD_BATCH_H__
+
+#include <vector>
+
+#include "ngslib/bam_record.h"
+
+namespace ngslib {
+
+    class Bam;
+    class BamIterator;
+
+    /* A batch of BamRecord slots which is filled by Bam::read_batch() or
+     * BamIterator::read_batch().
+     *
+     * Every slot holds a pre-allocated bam1_t. The slots (and the memory of
+     * their bam1_t data) are kept across calls, so reading
+     * batch after batch into the same RecordBatch does no malloc per record
+     * once the buffers have grown to the size of the largest record.
+     * */
+    class RecordBatch {
+
+    private:
+        std::vector<BamRecord> _records;  // All the slots, never shrink.
+        size_t _size;                     // The number of filled slots.
+
+        // Return the first unfilled slot, append a new one if all are in use.
+        BamRecord &_free_slot();
+
+        friend class Bam;
+        friend class BamIterator;
+
+    public:
+        RecordBatch() : _size(0) {}
+        explicit RecordBatch(size_t n) : _size(0) { reserve(n); }
+
+        // Pre-allocate at least `n` slots.
+        void reserve(size_t n);
+
+        // The number of records in this batch.
+        size_t size() const { return _size; }
+
+        // The number of pre-allocated slots.
+        size_t capacity() const { return _records.size(); }
+
+        bool empty() const { return _size == 0; }
+
+        // Forget all the records but keep the slots and their buffers.
+        void clear() { _size = 0; }
+
+        BamRecord &operator[](size_t i) { return _records[i]; }
+        const BamRecord &operator[](size_t i) const { return _records[i]; }
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_RECORD_BATCH_H__
@@ -0,0 +1,72 @@
+// The C++ codes for STL-style iteration of BAM records
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_RECORD_ITERATOR_H__
+#define __INCLUDE_NGSLIB_RECORD_ITERATOR_H__
+
+#include <cstddef>
+#include <iterator>
+
+#include "ngslib/bam_record.h"
+
+namespace ngslib {
+
+    /* An input iterator over the records of a reader, which could be any class
+     * with `int next(BamRecord &br)` returning < 0 at the end (Bam, BamIterator).
+     *
+     * It yields a reference to one record owned by the reader, which is reused
+     * (overwritten) by every increment, so no record is copied in the loop:
+     *
+     *      for (auto &r : bam.fetch("chr1:1-1000")) { ... }
+     *
+     * As any input iterator, it's single pass. Copy the record if it's needed
+     * after the iterator moves on.
+     * */
+    template<typename Reader>
+    class RecordInputIterator {
+
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef BamRecord value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef BamRecord *pointer;
+        typedef BamRecord &reference;
+
+    private:
+        Reader *_reader;  // NULL at the end
+        BamRecord *_br;
+
+        void _next() {
+            if (_reader && _reader->next(*_br) < 0) _reader = NULL;
+        }
+
+    public:
+        // The end iterator
+        RecordInputIterator() : _reader(NULL), _br(NULL) {}
+
+        // Read the first record.
+        RecordInputIterator(Reader *reader, BamRecord *br) : _reader(reader), _br(br) { _next(); }
+
+        reference operator*() const { return *_br; }
+        pointer operator->() const { return _br; }
+
+        RecordInputIterator &operator++() {
+            _next();
+            return *this;
+        }
+
+        RecordInputIterator operator++(int) {
+            RecordInputIterator it = *this;
+            _next();
+            return it;
+        }
+
+        // All the iterators reach the end are equal.
+        bool operator==(const RecordInputIterator &it) const { return _reader == it._reader; }
+        bool operator!=(const RecordInputIterator &it) const { return _reader != it._reader; }
+    };
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_RECORD_ITERATOR_H__
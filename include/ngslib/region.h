@@ -0,0 +1,86 @@
+// The C++ codes for genome regions
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_REGION_H__
+#define __INCLUDE_NGSLIB_REGION_H__
+
+#include <string>
+#include <vector>
+
+#include <htslib/hts.h>
+#include "ngslib/bam_header.h"
+
+namespace ngslib {
+
+    /* A region on the reference genome defined by the target id in BAM header.
+     *
+     * @field tid   target id, HTS_IDX_NOCOOR for the unmapped reads at the end
+     *              of file.
+     * @field beg   0-based start, inclusive
+     * @field end   0-based end, exclusive
+     * */
+    struct GenomeRegion {
+        int tid;
+        hts_pos_t beg;
+        hts_pos_t end;
+
+        GenomeRegion() : tid(-1), beg(0), end(0) {}
+        GenomeRegion(int t, hts_pos_t b, hts_pos_t e) : tid(t), beg(b), end(e) {}
+
+        hts_pos_t length() const { return end - beg; }
+
+        // Region string could be parsed by hts_parse_reg(): REF:START-END in
+        // 1-based coordinate, or '*' for the unmapped reads.
+        std::string to_string(const BamHeader &hdr) const;
+    };
+
+    /** Parse region strings by sam_parse_region().
+     *
+     * @param hdr      BAM header
+     * @param regions  Region strings in the forms of REF, REF:START-END, etc. (see
+     *                 Bam::fetch), '.' for the whole file or '*' for the unmapped
+     *                 reads at the end of file.
+     * @return regions in the same order of input. The end of region is clipped to
+     *         the length of reference, '.' is expanded to all the reference
+     *         sequences plus '*'.
+     *
+     * @exception Throws an invalid_argument if any region could not be parsed.
+     */
+    std::vector<GenomeRegion> parse_regions(const BamHeader &hdr,
+                                            const std::vector<std::string> &regions);
+
+    /** Load regions from a BED file (plain text or compressed by bgzip/gzip).
+     *
+     * Lines start with '#', 'track' or 'browser' are skipped. The first three
+     * columns of BED are: CHROM, START (0-based), END (exclusive).
+     *
+     * @exception Throws an invalid_argument if file could not be read or the
+     * reference name is not found in header.
+     */
+    std::vector<GenomeRegion> load_bed(const BamHeader &hdr, const std::string &bed_fn);
+
+    /** Sort regions by (tid, beg) and merge the overlapping or nearby ones.
+     *
+     * @param regions    The regions to merge
+     * @param merge_gap  Two regions on the same reference are merged if the gap
+     *                   between them is <= merge_gap bp. Default: 0, only merge
+     *                   the overlapping and the bookended regions.
+     * @return sorted and non-overlapping regions, '*' (unmapped) is the last one.
+     */
+    std::vector<GenomeRegion> merge_regions(std::vector<GenomeRegion> regions,
+                                            hts_pos_t merge_gap = 0);
+
+    /** Split the reference sequences in BAM header into shards.
+     *
+     * @param hdr         BAM header
+     * @param shard_size  Max length (bp) of each shard, must be > 0.
+     * @return shards in the order of reference sequences in the header.
+     *
+     * @exception Throws an invalid_argument if shard_size <= 0.
+     */
+    std::vector<GenomeRegion> split_genome(const BamHeader &hdr, hts_pos_t shard_size);
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_REGION_H__
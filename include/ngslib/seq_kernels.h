@@ -0,0 +1,61 @@
+// The C++ codes for decoding the bases and qualities of BAM records by SIMD
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_SEQ_KERNELS_H__
+#define __INCLUDE_NGSLIB_SEQ_KERNELS_H__
+
+#include <stdint.h>
+
+namespace ngslib {
+
+    /* The kernels below are dispatched at runtime to the best instruction set
+     * of the CPU: AVX2, SSSE3, or the scalar code. They write into buffers
+     * provided by the caller, so nothing is allocated per record.
+     * */
+    struct SimdLevel {
+        enum {
+            SCALAR,
+            SSSE3,
+            AVX2
+        };
+    };
+
+    // The instruction set used by the kernels, see SimdLevel.
+    int simd_level();
+
+    /** Decode `n` bases packed in 4 bits (see bam_get_seq()) to "ACGTN" (the
+     *  other IUPAC codes are decoded to ' ', as _BASES in bam_record.h).
+     *
+     * @param seq  The packed bases
+     * @param n    The number of bases
+     * @param out  At least `n` chars, not terminated by '\0'.
+     */
+    void decode_bases(const uint8_t *seq, int n, char *out);
+
+    // Decode the reverse complement of `n` packed bases into `out`.
+    void decode_bases_revcomp(const uint8_t *seq, int n, char *out);
+
+    /** Add `offset` to `n` Phred qualities (see bam_get_qual()), and write
+     *  them into `out` in the reverse order if `reverse`.
+     */
+    void decode_quals(const uint8_t *qual, int n, int offset, bool reverse, char *out);
+
+    // The statistics of the qualities of a read.
+    struct QualStats {
+        int n;          // The number of qualities
+        int64_t sum;    // The sum of qualities
+        int min;        // The minimum quality, -1 if n is 0.
+        int n_below;    // The number of qualities < threshold
+
+        double mean() const { return n > 0 ? (double)sum / n : -1; }
+    };
+
+    /** The sum, minimum and the number of qualities below `threshold` of `n`
+     *  Phred qualities, in one pass.
+     */
+    QualStats qual_stats(const uint8_t *qual, int n, int threshold);
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_SEQ_KERNELS_H__
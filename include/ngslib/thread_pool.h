@@ -0,0 +1,68 @@
+// The C++ codes for sharing an htslib thread pool among files
+// Author: Shujia Huang
+// Date: 2026-10-17
+
+#ifndef __INCLUDE_NGSLIB_THREAD_POOL_H__
+#define __INCLUDE_NGSLIB_THREAD_POOL_H__
+
+#include <memory>
+
+#include <htslib/hts.h>
+#include <htslib/thread_pool.h>
+
+namespace ngslib {
+
+    /*! A wrapper of `htsThreadPool` defined in hts.h:
+     *
+     *  @field pool   The hts_tpool pointer created by hts_tpool_init()
+     *  @field qsize  Size of the job queue, 0 lets htslib choose (2 * nthreads)
+     *
+     *  One pool can be attached to any number of opened files (Bam, and Vcf
+     *  in the future) to inflate/deflate their BGZF blocks or to decode/encode
+     *  their CRAM containers in parallel. The pool must be alive until all the
+     *  attached files have been closed, so ThreadPool is always handled by a
+     *  std::shared_ptr (`SharedThreadPool`) and every file holds a reference.
+     */
+    class ThreadPool {
+
+    private:
+        htsThreadPool _tp;
+
+        ThreadPool(const ThreadPool &tp) = delete;             // reject using copy constructor (C++11 style).
+        ThreadPool &operator=(const ThreadPool &tp) = delete;  // reject using copy/assignment operator (C++11 style).
+
+    public:
+        /** Create a pool with `nthreads` worker threads.
+         *
+         * @param nthreads  Number of worker threads, must be > 0
+         * @param qsize     Size of the job queue, 0 for the htslib default
+         *
+         * @exception Throws an invalid_argument if the pool can not be created.
+         */
+        explicit ThreadPool(int nthreads, int qsize = 0);
+        ~ThreadPool();
+
+        // Return the number of worker threads in this pool.
+        int size() const { return hts_tpool_size(_tp.pool); }
+
+        // Return the `htsThreadPool` pointer which can be passed to htslib directly.
+        htsThreadPool *tp() { return &_tp; }
+
+        /** Attach this pool to an opened SAM/BAM/CRAM/VCF/BCF file.
+         *
+         * @param fp  The file pointer, samFile is as the same as htsFile
+         * @return    0 on success, -1 on error
+         */
+        int attach(htsFile *fp) { return hts_set_thread_pool(fp, &_tp); }
+    };
+
+    typedef std::shared_ptr<ThreadPool> SharedThreadPool;
+
+    // Create a ThreadPool which can be shared by many files.
+    inline SharedThreadPool make_thread_pool(int nthreads, int qsize = 0) {
+        return SharedThreadPool(new ThreadPool(nthreads, qsize));
+    }
+
+}  // namespace ngslib
+
+#endif  // #ifndef __INCLUDE_NGSLIB_THREAD_POOL_H__
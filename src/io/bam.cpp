@@ -26,12 +26,43 @@ namespace ngslib {
     }
 
     Bam::~Bam() {
+        // Stop reading ahead before closing the file.
+        _prefetch.reset();
+
         // sam_close function is an alias name of hts_close.
         if (_fp) sam_close(_fp);
-        if (_idx) hts_idx_destroy(_idx);
+        if (_idx && !_shared_idx) hts_idx_destroy(_idx);  // The shared one is released by _shared_idx.
         if (_itr) sam_itr_destroy(_itr);
 
         _io_status = -1;
+        // _tpool must be released after closing _fp, which is guaranteed by
+        // destructing members after the body of destructor.
+    }
+
+    void Bam::set_threads(int nthreads) {
+        set_thread_pool(make_thread_pool(nthreads));
+    }
+
+    void Bam::set_thread_pool(const SharedThreadPool &tp) {
+
+        if (!tp) {
+            throw std::invalid_argument("[bam.cpp::Bam:set_thread_pool] The thread pool is NULL.");
+        }
+
+        if (_tpool) {  // htslib does not support switching pool on an opened file.
+            if (_tpool == tp) return;
+            throw std::invalid_argument("[bam.cpp::Bam:set_thread_pool] A thread pool "
+                                        "has already been attached to " + _fname);
+        }
+
+        if (!_fp || tp->attach(_fp) != 0) {
+            throw std::invalid_argument("[bam.cpp::Bam:set_thread_pool] Fail to attach "
+                                        "the thread pool to " + _fname);
+        }
+
+        // Keep a reference to the pool, it will be released after all the files
+        // using it have been closed.
+        _tpool = tp;
     }
 
     samFile *Bam::fp() const {
@@ -40,7 +71,7 @@ namespace ngslib {
 
     BamHeader &Bam::header() {
         if (!_hdr) {
-            _hdr = BamHeader(_fp);  // call copy constructor of BamHeader.
+            _hdr = BamHeader(_fp);  // Moved, the header is not duplicated.
         }
         return _hdr;
     }
@@ -52,11 +83,90 @@ namespace ngslib {
         return _idx;
     }
 
+    void Bam::_stop_prefetch(const char *func) {
+
+        if (!_prefetch || !_prefetch->running()) return;
+
+        // The records read ahead are neither delivered nor could be read again
+        // from _fp, unless the stream has ended or a new fetch() is coming.
+        if (_io_status >= 0) {
+            throw std::invalid_argument("[bam.cpp::Bam:" + std::string(func) + "] Records are being "
+                                        "read ahead, call it before reading, after fetch() or at "
+                                        "the end of stream.");
+        }
+        _prefetch->stop();
+    }
+
+    void Bam::set_prefetch(size_t depth) {
+
+        _stop_prefetch("set_prefetch");
+        _prefetch.reset();
+        if (depth > 0) _prefetch.reset(new PrefetchReader(depth));
+    }
+
+    void Bam::set_fields(int fields) {
+
+        if (!_fp) {
+            throw std::invalid_argument("[bam.cpp::Bam:set_fields] The file is not opened.");
+        }
+        _stop_prefetch("set_fields");  // _fp is read by the producer.
+
+        _fields = fields | Fields::FLAG;
+        if (_filter.min_mapq > 0) _fields |= Fields::MAPQ;  // Needed by the filter.
+        if (hts_get_format(_fp)->format != cram) return;
+
+        int ret = hts_set_opt(_fp, CRAM_OPT_REQUIRED_FIELDS, _fields);
+
+        // MD/NM are generated from the sequence and reference, skip them if no
+        // tag is needed.
+        if (ret == 0 && !(_fields & Fields::AUX)) ret = hts_set_opt(_fp, CRAM_OPT_DECODE_MD, 0);
+
+        if (ret != 0) {
+            throw std::invalid_argument("[bam.cpp::Bam:set_fields] Fail to set the required "
+                                        "fields of " + _fname);
+        }
+    }
+
+    void Bam::set_filter(const ReadFilter &filter) {
+
+        _stop_prefetch("set_filter");  // The producer is restarted with the new filter.
+        _filter = filter;
+        if (_filter.min_mapq > 0 && !(_fields & Fields::MAPQ)) set_fields(_fields);
+    }
+
+    void Bam::set_filter(const std::string &expr) {
+
+        if (_fp) _stop_prefetch("set_filter");
+        if (!_fp || hts_set_filter_expression(_fp, expr.empty() ? NULL : expr.c_str()) != 0) {
+            throw std::invalid_argument("[bam.cpp::Bam:set_filter] Invalid filter "
+                                        "expression: " + expr);
+        }
+    }
+
+    SharedIndex Bam::shared_idx() {
+        if (!_idx) {
+            this->index_load();
+        }
+        return _shared_idx;
+    }
+
     void Bam::index_load() {
 
         if (_idx)
             return;
 
+        // BAI/CSI of BAM (or bgzip compressed SAM) is not bound to _fp, share it.
+        const htsFormat *fmt = hts_get_format(_fp);
+        if (fmt->format == bam || (fmt->format == sam && fmt->compression == bgzf)) {
+            try {
+                _shared_idx = IndexCache::instance().load(_fname);
+                _idx = _shared_idx.get();
+                return;
+            } catch (const std::invalid_argument &) {
+                // Remote file or customized index name, let htslib find it below.
+            }
+        }
+
         _idx = sam_index_load(_fp, _fname.c_str());
         if (!_idx) {
             throw std::invalid_argument(
@@ -67,12 +177,24 @@ namespace ngslib {
         }
     }
 
+    int Bam::index_build(int min_shift, int nthreads) {
+
+        int ret = sam_index_build3(_fname.c_str(), NULL, min_shift, nthreads);
+        if (ret == 0) IndexCache::instance().drop(_fname);  // The old one may be cached.
+        return ret;
+    }
+
+    IndexStats Bam::index_stats() {
+        return ngslib::index_stats(idx(), header());
+    }
+
     // fetch 这个函数在使用多线程的时候会不会发生问题？尝试多区间处理方式？
     // 特别是类成员参数, _fp/_idx 在并行处理时是否存在问题? (htslib/thread_pool.h 参考一下)
     // 最好不要在一份文件中做多线程，而是以文件为单位跑多线程，从而在根上避免？
     // Create a SAM/BAM/CRAM iterator for one region.
-    bool Bam::fetch(const std::string &region) {
+    Bam &Bam::fetch(const std::string &region) {
 
+        if (_prefetch) _prefetch->stop();  // _fp and _itr are used by the producer.
         if (!_idx) index_load();  // May not be thread safety?
         if (!_hdr) _hdr = BamHeader(_fp);  // If NULL, set BAM header to _hdr.
 
@@ -84,11 +206,14 @@ namespace ngslib {
             throw std::invalid_argument("[bam.cpp::Bam:fetch] Fail to fetch the "
                                         "alignment data in : " + region);
         }
-        return _itr != NULL;
+
+        _io_status = 0;  // Ready to read the new region.
+        return *this;
     }
 
-    bool Bam::fetch(const std::string &seq_name, hts_pos_t beg, hts_pos_t end) {
+    Bam &Bam::fetch(const std::string &seq_name, hts_pos_t beg, hts_pos_t end) {
 
+        if (_prefetch) _prefetch->stop();
         if (!_idx) index_load();  // May not be thread safety?
         if (!_hdr) _hdr = BamHeader(_fp);  // If NULL, set BAM header to _hdr.
 
@@ -102,6 +227,54 @@ namespace ngslib {
                                         "alignment data in: " + region);
         }
 
+        _io_status = 0;
+        return *this;
+    }
+
+    Bam &Bam::fetch(const std::vector<std::string> &regions, hts_pos_t merge_gap) {
+
+        if (!_hdr) _hdr = BamHeader(_fp);  // If NULL, set BAM header to _hdr.
+        _fetch_regions(merge_regions(parse_regions(_hdr, regions), merge_gap));
+
+        _io_status = 0;
+        return *this;
+    }
+
+    Bam &Bam::fetch_bed(const std::string &bed_fn, hts_pos_t merge_gap) {
+
+        if (!_hdr) _hdr = BamHeader(_fp);  // If NULL, set BAM header to _hdr.
+        _fetch_regions(merge_regions(load_bed(_hdr, bed_fn), merge_gap));
+
+        _io_status = 0;
+        return *this;
+    }
+
+    bool Bam::_fetch_regions(const std::vector<GenomeRegion> &regions) {
+
+        if (_prefetch) _prefetch->stop();
+        if (!_idx) index_load();
+        if (regions.empty()) {
+            throw std::invalid_argument("[bam.cpp::Bam:fetch] No region to fetch.");
+        }
+
+        // Reset a iterator, An iterator on success; NULL on failure
+        if (_itr) sam_itr_destroy(_itr);
+
+        _itr_regions.clear();
+        std::vector<char *> regarray;
+        for (size_t i = 0; i < regions.size(); ++i) {
+            _itr_regions.push_back(regions[i].to_string(_hdr));
+        }
+        for (size_t i = 0; i < _itr_regions.size(); ++i) {
+            regarray.push_back(&_itr_regions[i][0]);
+        }
+
+        _itr = sam_itr_regarray(_idx, _hdr.h(), &regarray[0], regarray.size());
+        if (!_itr) {
+            throw std::invalid_argument("[bam.cpp::Bam:fetch] Fail to fetch the alignment "
+                                        "data in " + tostring(regions.size()) + " regions.");
+        }
+
         return _itr != NULL;
     }
 
@@ -112,10 +285,13 @@ namespace ngslib {
         // If NULL, initial the BAM header by _fp.
         if (!_hdr.h()) _hdr = BamHeader(_fp);
 
-        if (!_itr) {
-            _io_status = br.load_read(_fp, _hdr.h());
+        if (_prefetch) {
+            if (!_prefetch->running()) _prefetch->start(_fp, _hdr.h(), _itr, _filter);
+            _io_status = _prefetch->next(br, _fields);
+        } else if (!_itr) {
+            _io_status = br.load_read(_fp, _hdr.h(), _fields, _filter.empty() ? NULL : &_filter);
         } else {
-            _io_status = br.next_read(_fp, _itr);
+            _io_status = br.next_read(_fp, _itr, _fields, _filter.empty() ? NULL : &_filter);
         }
 
         // Destroy BamRecord and set br to be NULL if fail to read data
@@ -124,6 +300,32 @@ namespace ngslib {
         return _io_status;
     }
 
+    size_t Bam::read_batch(RecordBatch &batch, size_t n) {
+
+        batch.clear();
+        batch.reserve(n);
+
+        while (batch.size() < n) {
+            if (read(batch._free_slot()) < 0) break;
+            ++batch._size;
+        }
+
+        return batch.size();
+    }
+
+    size_t Bam::read_batch(ColumnBatch &batch, size_t n) {
+
+        batch.clear();
+        batch.reserve(n);
+
+        while (batch.size() < n) {
+            if (read(batch._br) < 0) break;
+            batch.append(batch._br);
+        }
+
+        return batch.size();
+    }
+
     std::ostream &operator<<(std::ostream &os, const Bam &b) {
 
         if (b) {
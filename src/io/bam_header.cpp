@@ -1,4 +1,5 @@
 #include <stdexcept>
+#include <cstring>
 
 #include <htslib/hts.h>
 #include "ngslib/bam_header.h"
@@ -22,18 +23,26 @@ namespace ngslib {
     }
 
     BamHeader &BamHeader::operator=(const BamHeader &bh) {
+        return *this = bh._h;
+    }
 
-        // release _h pointer if _h is not NULL
-        sam_hdr_destroy(_h);
-        _h = sam_hdr_dup(bh._h);
+    BamHeader &BamHeader::operator=(BamHeader &&bh) noexcept {
+
+        if (this != &bh) {
+            sam_hdr_destroy(_h);
+            _h = bh._h;
+            bh._h = NULL;
+        }
         return *this;
     }
 
     BamHeader &BamHeader::operator=(const sam_hdr_t *hdr) {
 
+        if (_h == hdr) return *this;  // Self-assignment.
+
         // release _h pointer if _h is not NULL
         sam_hdr_destroy(_h);
-        _h = sam_hdr_dup(hdr);
+        _h = hdr ? sam_hdr_dup(hdr) : NULL;
         return *this;
     }
 
@@ -50,6 +59,20 @@ namespace ngslib {
         _h = NULL;
     }
 
+    bool BamHeader::same_sequences(const BamHeader &bh) const {
+
+        if (!_h || !bh._h) return false;
+        if (_h->n_targets != bh._h->n_targets) return false;
+
+        for (int i = 0; i < _h->n_targets; ++i) {
+            if (_h->target_len[i] != bh._h->target_len[i] ||
+                std::strcmp(_h->target_name[i], bh._h->target_name[i]) != 0)
+                return false;
+        }
+
+        return true;
+    }
+
     int BamHeader::name2id(const std::string &name) {
         int tid = sam_hdr_name2tid(_h, name.c_str());
 
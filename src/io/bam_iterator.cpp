@@ -19,20 +19,39 @@ namespace ngslib {
         this->fetch(region);
     }
 
+    BamIterator::BamIterator(samFile *fp, const SharedIndex &idx,
+                             sam_hdr_t *hdr) : _itr(NULL), _shared_idx(idx) {
+        _fp = fp;
+        _idx = idx.get();
+        _hdr = hdr;
+    }
+
+    BamIterator::BamIterator(samFile *fp, const SharedIndex &idx, sam_hdr_t *hdr,
+                             const std::string &region) : _itr(NULL), _shared_idx(idx) {
+        _fp = fp;
+        _idx = idx.get();
+        _hdr = hdr;
+        this->fetch(region);
+    }
+
     BamIterator::BamIterator(const BamIterator &bi) {
 
         _fp = bi._fp;
         _idx = bi._idx;
+        _shared_idx = bi._shared_idx;
         _hdr = bi._hdr;
         _itr = bi._itr;
+        _filter = bi._filter;
     }
 
     BamIterator &BamIterator::operator=(const BamIterator &bi) {
 
         _fp = bi._fp;
         _idx = bi._idx;
+        _shared_idx = bi._shared_idx;
         _hdr = bi._hdr;
         _itr = bi._itr;
+        _filter = bi._filter;
 
         return *this;
     }
@@ -53,13 +72,22 @@ namespace ngslib {
         return _itr != NULL;
     }
 
+    void BamIterator::set_filter(const std::string &expr) {
+
+        if (!_fp || hts_set_filter_expression(_fp, expr.empty() ? NULL : expr.c_str()) != 0) {
+            throw std::invalid_argument("[bam_iterator.cpp::BamIterator:set_filter] Invalid "
+                                        "filter expression: " + expr);
+        }
+    }
+
     int BamIterator::next(BamRecord &br) {
 
+        const ReadFilter *filter = _filter.empty() ? NULL : &_filter;
         int io_status;
         if (!_itr) {
-            io_status = br.load_read(_fp, _hdr);
+            io_status = br.load_read(_fp, _hdr, Fields::ALL, filter);
         } else {
-            io_status = br.next_read(_fp, _itr);
+            io_status = br.next_read(_fp, _itr, Fields::ALL, filter);
         }
 
         // Destroy BamRecord and set br to be NULL if fail to read data
@@ -69,6 +97,36 @@ namespace ngslib {
         return io_status;
     }
 
+    size_t BamIterator::read_batch(RecordBatch &batch, size_t n, int &io_status) {
+
+        batch.clear();
+        batch.reserve(n);
+
+        io_status = 0;
+        while (batch.size() < n) {
+            io_status = next(batch._free_slot());
+            if (io_status < 0) break;
+            ++batch._size;
+        }
+
+        return batch.size();
+    }
+
+    size_t BamIterator::read_batch(ColumnBatch &batch, size_t n, int &io_status) {
+
+        batch.clear();
+        batch.reserve(n);
+
+        io_status = 0;
+        while (batch.size() < n) {
+            io_status = next(batch._br);
+            if (io_status < 0) break;
+            batch.append(batch._br);
+        }
+
+        return batch.size();
+    }
+
     void BamIterator::destroy() {
 
         if (_itr) sam_itr_destroy(_itr);
@@ -79,6 +137,7 @@ namespace ngslib {
         // of Bam object.
         _fp = NULL;
         _idx = NULL;
+        _shared_idx.reset();
         _hdr = NULL;
         return;
     }
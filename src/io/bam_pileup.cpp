@@ -0,0 +1,182 @@
+#include <stdexcept>
+
+#include <htslib/sam.h>
+#include "ngslib/bam_pileup.h"
+
+namespace ngslib {
+
+    BamPileup::BamPileup(const std::vector<std::string> &fns, int nthreads) :
+            _mplp(NULL), _filter(0, BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP),
+            _min_baseq(13), _max_depth(8000), _overlaps(true), _tid(-1), _pos(-1) {
+
+        if (fns.empty()) {
+            throw std::invalid_argument("[bam_pileup.cpp::BamPileup] No input file.");
+        }
+
+        SharedThreadPool tp;
+        if (nthreads > 0) tp = make_thread_pool(nthreads);
+
+        for (size_t i = 0; i < fns.size(); ++i) {
+
+            std::unique_ptr<_Sample> s(new _Sample);
+            s->bam.reset(new Bam(fns[i], "r"));
+            s->filter = &_filter;
+            if (tp) s->bam->set_thread_pool(tp);
+
+            // Aux tags are not used by pileup, skip decoding them for CRAM.
+            s->bam->set_fields(Fields::ALL & ~(Fields::AUX | Fields::RGAUX));
+
+            if (!_samples.empty() && !s->bam->header().same_sequences(header())) {
+                throw std::invalid_argument("[bam_pileup.cpp::BamPileup] The reference sequences "
+                                            "of " + fns[i] + " are different from " + fns[0]);
+            }
+
+            _samples.push_back(std::move(s));
+        }
+
+        _n_plp.resize(_samples.size(), 0);
+        _plp.resize(_samples.size(), NULL);
+        _columns.resize(_samples.size());
+    }
+
+    BamPileup::BamPileup(const std::string &fn, int nthreads) :
+            BamPileup(std::vector<std::string>(1, fn), nthreads) {}
+
+    BamPileup::~BamPileup() {
+        if (_mplp) bam_mplp_destroy(_mplp);
+    }
+
+    void BamPileup::set_max_depth(int max_depth) {
+        _max_depth = max_depth;
+        if (_mplp) bam_mplp_set_maxcnt(_mplp, _max_depth);
+    }
+
+    void BamPileup::set_overlaps(bool overlaps) {
+        _overlaps = overlaps;
+    }
+
+    int BamPileup::_read(void *data, bam1_t *b) {
+
+        _Sample *s = static_cast<_Sample *>(data);
+        samFile *fp = s->bam->fp();
+
+        // Reads failing the filter never go into the pileup.
+        int ret;
+        do {
+            ret = s->itr ? sam_itr_next(fp, s->itr, b) : sam_read1(fp, s->bam->header().h(), b);
+        } while (ret >= 0 && !s->filter->pass(b));
+
+        return ret;
+    }
+
+    void BamPileup::_init_mplp() {
+
+        if (_mplp) bam_mplp_destroy(_mplp);
+
+        std::vector<void *> data(_samples.size());
+        for (size_t i = 0; i < _samples.size(); ++i) {
+            data[i] = _samples[i].get();
+        }
+
+        _mplp = bam_mplp_init(data.size(), &BamPileup::_read, &data[0]);
+        if (!_mplp) {
+            throw std::invalid_argument("[bam_pileup.cpp::BamPileup:_init_mplp] Fail to "
+                                        "initialize the pileup.");
+        }
+
+        if (_overlaps) bam_mplp_init_overlaps(_mplp);
+        bam_mplp_set_maxcnt(_mplp, _max_depth);
+    }
+
+    BamPileup &BamPileup::fetch(const std::string &region) {
+
+        std::vector<GenomeRegion> regions = parse_regions(header(), std::vector<std::string>(1, region));
+        if (regions.size() != 1 || regions[0].tid < 0) {
+            throw std::invalid_argument("[bam_pileup.cpp::BamPileup:fetch] Only a region on one "
+                                        "reference sequence could be fetched: " + region);
+        }
+
+        const GenomeRegion &r = regions[0];
+        for (size_t i = 0; i < _samples.size(); ++i) {
+
+            _Sample &s = *_samples[i];
+            if (s.itr) sam_itr_destroy(s.itr);
+            s.itr = sam_itr_queryi(s.bam->idx(), r.tid, r.beg, r.end);
+            if (!s.itr) {
+                throw std::invalid_argument("[bam_pileup.cpp::BamPileup:fetch] Fail to fetch " +
+                                            region + " in " + s.bam->fp()->fn);
+            }
+        }
+
+        _region = r;
+        if (_mplp) {  // Start over.
+            bam_mplp_destroy(_mplp);
+            _mplp = NULL;
+        }
+
+        return *this;
+    }
+
+    int BamPileup::next() {
+
+        if (!_mplp) _init_mplp();
+
+        int ret;
+        while ((ret = bam_mplp64_auto(_mplp, &_tid, &_pos, &_n_plp[0], &_plp[0])) > 0) {
+
+            // Reads in region cover the positions out of it.
+            if (_region.tid >= 0) {
+                if (_tid != _region.tid || _pos >= _region.end) return -1;
+                if (_pos < _region.beg) continue;
+            }
+
+            for (size_t i = 0; i < _samples.size(); ++i) {
+                _fill_column(i);
+            }
+            return 0;
+        }
+
+        return ret == 0 ? -1 : -2;
+    }
+
+    void BamPileup::_fill_column(size_t i) {
+
+        PileupColumn &c = _columns[i];
+        c.clear();
+
+        const bam_pileup1_t *p = _plp[i];
+        for (int j = 0; j < _n_plp[i]; ++j, ++p) {
+
+            const bam1_t *b = p->b;
+            uint8_t q = 0;
+            char base;
+            if (p->is_refskip) {  // is_del is also set for reference skip.
+                base = '>';
+            } else if (p->is_del) {
+                base = '*';
+            } else {
+                q = bam_get_qual(b)[p->qpos];
+                if (q < _min_baseq) continue;
+                base = seq_nt16_str[bam_seqi(bam_get_seq(b), p->qpos)];
+            }
+
+            c.bases.push_back(base);
+            c.quals.push_back(q);
+            c.mapqs.push_back(b->core.qual);
+            c.reverse.push_back(bam_is_rev(b) ? 1 : 0);
+            c.indels.push_back(p->indel);
+            c.qpos.push_back(p->qpos);
+            c.reads.push_back(b);
+        }
+    }
+
+    size_t BamPileup::depth() const {
+
+        size_t n = 0;
+        for (size_t i = 0; i < _columns.size(); ++i) {
+            n += _columns[i].size();
+        }
+        return n;
+    }
+
+}  // namespace ngslib
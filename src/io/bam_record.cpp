@@ -1,5 +1,5 @@
 #include <stdexcept>
-#include <sstream>
+#include <cstring>
 
 #include <htslib/hts.h>
 #include "ngslib/bam_record.h"
@@ -9,122 +9,127 @@
 namespace ngslib {
 
     // The default constructor
-    BamRecord::BamRecord() : _b(NULL), _p_cigar_field(NULL), _n_cigar_op(0) {}
+    BamRecord::BamRecord() : _b(NULL), _fields(Fields::ALL), _n_aux(-1) {}
 
-    // _p_cigar_field member should be initialization to a NULL pointer in constructor function.
-    BamRecord::BamRecord(const BamRecord &b) : _p_cigar_field(NULL), _n_cigar_op(0) {
-        this->_b = bam_dup1(b._b);
-        this->_make_cigar_field();
+    BamRecord::BamRecord(const BamRecord &b) : _fields(b._fields), _n_aux(-1) {
+        this->_b = b._b ? bam_dup1(b._b) : NULL;
     }
 
-    BamRecord::BamRecord(const bam1_t *b) : _p_cigar_field(NULL), _n_cigar_op(0) {
-        this->_b = bam_dup1(b);
-        this->_make_cigar_field();
+    BamRecord::BamRecord(const bam1_t *b) : _fields(Fields::ALL), _n_aux(-1) {
+        this->_b = b ? bam_dup1(b) : NULL;
     }
 
     BamRecord &BamRecord::operator=(const BamRecord &b) {
 
-        if (this->_b)
-            bam_destroy1(this->_b);
+        if (this == &b)
+            return *this;
 
-        this->_b = bam_dup1(b._b);
-        this->_make_cigar_field();
+        *this = b._b;  // Reuse the memory of _b.
+        this->_fields = b._fields;
 
         return *this;
     }
 
-    BamRecord &BamRecord::operator=(const bam1_t *b) {
+    BamRecord &BamRecord::operator=(BamRecord &&b) noexcept {
 
-        if (this->_b)
+        if (this != &b) {
             bam_destroy1(this->_b);
-
-        this->_b = bam_dup1(b);
-        this->_make_cigar_field();
+            this->_b = b._b;
+            this->_fields = b._fields;
+            this->_n_aux = -1;
+            b._b = NULL;
+        }
 
         return *this;
     }
 
-    void BamRecord::_make_cigar_field() {
-
-        if (_p_cigar_field)
-            delete[] _p_cigar_field;
-
-        if (!_b)
-            return;
-
-        _n_cigar_op = _b->core.n_cigar;
-        _p_cigar_field = new CigarField[_n_cigar_op];
-
-        if (!_p_cigar_field) {
-            throw std::invalid_argument("BamRecord::_make_cigar_field: Fail to "
-                                        "alloc memory space for CigarField.");
-        }
+    BamRecord &BamRecord::operator=(const bam1_t *b) {
 
-        uint32_t *c = bam_get_cigar(_b);
-        for (size_t i = 0; i < _n_cigar_op; i++) {
-            _p_cigar_field[i].op = bam_cigar_opchr(c[i]);
-            _p_cigar_field[i].len = bam_cigar_oplen(c[i]);
+        this->_fields = Fields::ALL;
+        this->_n_aux = -1;
+        if (this->_b == b)
+            return *this;
+
+        if (!b) {
+            destroy();
+        } else if (!this->_b) {
+            this->_b = bam_dup1(b);
+        } else if (!bam_copy1(this->_b, b)) {  // Copy into the memory of _b, no reallocation if it's large enough.
+            throw std::invalid_argument("[bam_record.cpp::BamRecord:operator=] Fail to copy the record.");
         }
 
-        return;
+        return *this;
     }
 
     void BamRecord::init() {
         if (_b) destroy();
         _b = bam_init1();
 
-        if (_p_cigar_field) {
-            delete[] _p_cigar_field;
-        }
-
-        _n_cigar_op = 0;
-        _p_cigar_field = NULL;
-
         return;
     }
 
     void BamRecord::destroy() {
         bam_destroy1(_b);
         _b = NULL;
-
-        if (_p_cigar_field) {
-            delete [] _p_cigar_field;
-            _p_cigar_field = NULL;
-            _n_cigar_op = 0;
-        }
+        _n_aux = -1;
 
         return;
     }
 
-    int BamRecord::load_read(samFile *fp, sam_hdr_t *h) {
+    void BamRecord::_undecoded(int fields, const char *func) const {
+        throw std::invalid_argument("[bam_record.cpp::BamRecord:" + std::string(func) + "] The "
+                                    "field(s) " + tostring(fields & ~_fields) + " of this record "
+                                    "are not decoded, add them by Bam::set_fields().");
+    }
+
+    bam1_t *BamRecord::exchange(bam1_t *b, int fields) {
+
+        bam1_t *old = _b;
+        _b = b;
+        _fields = fields;
+        _n_aux = -1;
+
+        return old;
+    }
+
+    int BamRecord::load_read(samFile *fp, sam_hdr_t *h, int fields, const ReadFilter *filter) {
 
         if (!this->_b)
             this->init();
 
-        int io_status = sam_read1(fp, h, this->_b);
+        this->_fields = fields;
+        this->_n_aux = -1;
+        // Skip the filtered records before making anything of them.
+        int io_status;
+        do {
+            io_status = sam_read1(fp, h, this->_b);
+        } while (io_status >= 0 && filter && !filter->pass(this->_b));
 
         // Destroy BamRecord and set br to be NULL if fail to read data or
         // hit the end of file.
         if (io_status < 0)
             this->destroy();
 
-        this->_make_cigar_field();
         return io_status;
     }
 
-    int BamRecord::next_read(samFile *fp, hts_itr_t *itr) {
+    int BamRecord::next_read(samFile *fp, hts_itr_t *itr, int fields, const ReadFilter *filter) {
 
         if (!this->_b)
             this->init();
 
-        int io_status = sam_itr_next(fp, itr, this->_b);
+        this->_fields = fields;
+        this->_n_aux = -1;
+        int io_status;
+        do {
+            io_status = sam_itr_next(fp, itr, this->_b);
+        } while (io_status >= 0 && filter && !filter->pass(this->_b));
 
         // Destroy BamRecord and set _b to be NULL if fail to read data or
         // hit the end of file.
         if (io_status < 0)
             this->destroy();
 
-        this->_make_cigar_field();
         return io_status;
     }
 
@@ -133,194 +138,138 @@ namespace ngslib {
         if (!r._b)
             return os;
 
-        os << r.qname() << "\t"
+        // The undecoded fields are printed as '*'.
+        std::string na = "*";
+        os << (r.has_fields(Fields::QNAME) ? r.qname() : na) << "\t"
            << r.flag() << "\t"
-           << r.tid() + 1 << "\t"
+           << (r.has_fields(Fields::RNAME) ? tostring(r.tid() + 1) : na) << "\t"
 
            // mapping position +1 to make 1-base coordinate.
-           << r.reference_start_pos() + 1 << "\t"
-           << r.mapq() << "\t"
-           << r.cigar() << "\t"
-           << r.mate_tid() + 1 << "\t"
+           << (r.has_fields(Fields::POS) ? tostring(r.reference_start_pos() + 1) : na) << "\t"
+           << (r.has_fields(Fields::MAPQ) ? tostring(r.mapq()) : na) << "\t"
+           << (r.has_fields(Fields::CIGAR) ? r.cigar() : na) << "\t"
+           << (r.has_fields(Fields::RNEXT) ? tostring(r.mate_tid() + 1) : na) << "\t"
 
            // mapping position +1 to make 1-base coordinate.
-           << r.mate_reference_start_pos() + 1 << "\t"
-           << r.insert_size() << "\t"
-           << r.query_sequence() << "\t"
-           << r.query_qual();
+           << (r.has_fields(Fields::PNEXT) ? tostring(r.mate_reference_start_pos() + 1) : na) << "\t"
+           << (r.has_fields(Fields::TLEN) ? tostring(r.insert_size()) : na) << "\t"
+           << (r.has_fields(Fields::SEQ) ? r.query_sequence() : na) << "\t"
+           << (r.has_fields(Fields::QUAL) ? r.query_qual() : na);
 
         return os;
     }
 
     std::string BamRecord::cigar() const {
-
-        if (!is_mapped()) return "*";  // empty
-
-        std::stringstream cig;
-        for (size_t i = 0; i < _n_cigar_op; ++i) {
-            cig << _p_cigar_field[i].len << _p_cigar_field[i].op;
-        }
-
-        return cig.str();
+        return cigar_view().to_string();
     }
 
     unsigned int BamRecord::align_length() const {
-
-        if (!is_mapped()) return 0;
-
-        unsigned int length = 0;
-        char op;
-        for (size_t i = 0; i < _n_cigar_op; ++i) {
-            op = _p_cigar_field[i].op;
-            if (op == 'M' ||
-                op == '=' ||
-                op == 'X') {
-                length += _p_cigar_field[i].len;
-            }
-        }
-
-        return length;
+        return cigar_view().aligned_length();
     }
 
     unsigned int BamRecord::match_length() const {
-
-        if (!is_mapped()) return 0;
-
-        unsigned int m_size = 0;
-        for (size_t i = 0; i < _n_cigar_op; i++) {
-            if (_p_cigar_field[i].op == 'M')
-                m_size += _p_cigar_field[i].len;
-        }
-
-        return m_size;
-    }
-
-    unsigned int BamRecord::_max_cigar_Opsize(const char op) const {
-
-        if (!is_mapped()) return 0;
-
-        unsigned int max_size = 0;
-        for (size_t i = 0; i < _n_cigar_op; i++) {
-            if (_p_cigar_field[i].op == op)
-                max_size = std::max(_p_cigar_field[i].len, max_size);
-        }
-
-        return max_size;
+        return cigar_view().sum(BAM_CMATCH);
     }
 
     unsigned int BamRecord::max_insertion_size() const {
-        return _max_cigar_Opsize('I');
+        return cigar_view().max(BAM_CINS);
     }
 
     unsigned int BamRecord::max_deletion_size() const {
-        return _max_cigar_Opsize('D');
+        return cigar_view().max(BAM_CDEL);
     }
 
     std::string BamRecord::query_sequence() const {
 
-        if (!_b) return "";
+        std::string seq;
+        query_sequence(seq);
+        return seq;
+    }
+
+    void BamRecord::query_sequence(std::string &seq, bool reverse_complement) const {
 
-        uint8_t *p = bam_get_seq(_b);
-        std::string seq(_b->core.l_qseq, 'N');  // initial by a batch of 'N'
-        for (size_t i = 0; i < _b->core.l_qseq; ++i)
-            seq[i] = _BASES[bam_seqi(p, i)];
+        _check_fields(Fields::SEQ, "query_sequence");
+        seq.clear();
+        if (!_b || _b->core.l_qseq <= 0) return;
 
-        return seq;
+        seq.resize(_b->core.l_qseq);
+        if (reverse_complement) {
+            decode_bases_revcomp(bam_get_seq(_b), _b->core.l_qseq, &seq[0]);
+        } else {
+            decode_bases(bam_get_seq(_b), _b->core.l_qseq, &seq[0]);
+        }
     }
 
     std::string BamRecord::query_qual(int offset) const {
 
-        if (!_b) return "";
+        std::string qual;
+        query_qual(qual, offset);
+        return qual;
+    }
 
-        uint8_t *p = bam_get_qual(_b);
-        if (!p) return "";
+    void BamRecord::query_qual(std::string &qual, int offset, bool reverse) const {
 
-        std::string qual(_b->core.l_qseq, ' ');
-        for (size_t i = 0; i < _b->core.l_qseq; ++i)
-            qual[i] = (char) (p[i] + offset);
+        _check_fields(Fields::QUAL, "query_qual");
+        qual.clear();
+        if (!_b || _b->core.l_qseq <= 0) return;
 
-        return qual;
+        uint8_t *p = bam_get_qual(_b);
+        if (p[0] == 0xff) return;  // No quality, '*' in SAM.
+
+        qual.resize(_b->core.l_qseq);
+        decode_quals(p, _b->core.l_qseq, offset, reverse, &qual[0]);
     }
 
     double BamRecord::mean_qqual() const {
 
+        _check_fields(Fields::QUAL, "mean_qqual");
         if (!is_mapped() || (_b->core.l_qseq <= 0))
             return -1;
 
-        double total_phred_score = 0;
-        uint8_t *p = bam_get_qual(_b);
-        for (size_t i = 0; i < _b->core.l_qseq; ++i)
-            total_phred_score += p[i];
+        return ngslib::qual_stats(bam_get_qual(_b), _b->core.l_qseq, 0).mean();
+    }
+
+    QualStats BamRecord::qual_stats(int threshold) const {
 
-        return total_phred_score / _b->core.l_qseq;
+        _check_fields(Fields::QUAL, "qual_stats");
+        return ngslib::qual_stats(_b ? bam_get_qual(_b) : NULL, _b ? _b->core.l_qseq : 0, threshold);
     }
 
     int32_t BamRecord::query_start_pos() const {
 
+        _check_fields(Fields::CIGAR, "query_start_pos");
         if (!is_mapped()) return -1;
 
-        int32_t p = 0;
-        // loop to the end
-        for (size_t i = 0; i < _n_cigar_op; ++i) {
-            if (_p_cigar_field[i].op == 'S') {
-                p += _p_cigar_field[i].len;
-            } else {
-                break;
-            }
-        }
-        return p;
+        return cigar_view().head_soft_clip();
     }
 
     int32_t BamRecord::query_start_pos_reverse() const {
 
+        _check_fields(Fields::CIGAR, "query_start_pos_reverse");
         if (!is_mapped()) return -1;
 
-        int32_t p = 0;
-        // loop from the end
-        for (size_t i = _n_cigar_op - 1; i >= 0; --i) {
-            if (_p_cigar_field[i].op == 'S') {
-                p += _p_cigar_field[i].len;
-            } else { // not a clip, stop counting
-                break;
-            }
-        }
-        return p;
+        return cigar_view().tail_soft_clip();
     }
 
     int32_t BamRecord::query_end_pos() const {
 
+        _check_fields(Fields::CIGAR, "query_end_pos");
         if (!is_mapped()) return -1;
 
-        int32_t p = 0;
-        // loop from the end
-        for (int32_t i = _n_cigar_op - 1; i >= 0; --i) {
-            if (_p_cigar_field[i].op == 'S') {
-                p += _p_cigar_field[i].len;
-            } else { // not a clip, so stop counting
-                break;
-            }
-        }
-        return (_b->core.l_qseq - p);
-
+        return _b->core.l_qseq - (int32_t)cigar_view().tail_soft_clip();
     }
 
     int32_t BamRecord::query_end_pos_reverse() const {
 
+        _check_fields(Fields::CIGAR, "query_end_pos_reverse");
         if (!is_mapped()) return -1;
 
-        int32_t p = 0;
-        for (size_t i = 0; i < _n_cigar_op; ++i) {
-            if (_p_cigar_field[i].op == 'S') {
-                p += _p_cigar_field[i].len;
-            } else { // not a clip, so stop counting
-                break;
-            }
-        }
-        return (_b->core.l_qseq - p);
+        return _b->core.l_qseq - (int32_t)cigar_view().head_soft_clip();
     }
 
     bool BamRecord::is_proper_orientation() const {
 
+        _check_fields(Fields::RNAME | Fields::POS | Fields::RNEXT | Fields::PNEXT, "is_proper_orientation");
         // _b is NULL
         if (!is_mapped() || !is_mate_mapped()) return false;
 
@@ -344,90 +293,204 @@ namespace ngslib {
         }
     }
 
-    bool BamRecord::has_tag(const std::string tag) const {
+    // The size of an element of B-array, 0 for an unknown type.
+    static int _aux_type_size(uint8_t type) {
+        switch (type) {
+            case 'c': case 'C': return 1;
+            case 's': case 'S': return 2;
+            case 'i': case 'I': case 'f': return 4;
+            default: return 0;
+        }
+    }
+
+    // The size of the value after the type byte `p`, -1 if it's broken.
+    static int64_t _aux_value_size(const uint8_t *p, const uint8_t *end) {
+
+        switch (*p) {
+            case 'A': case 'c': case 'C': return 1;
+            case 's': case 'S': return 2;
+            case 'i': case 'I': case 'f': return 4;
+            case 'd': return 8;
+            case 'Z': case 'H': {
+                const uint8_t *nul = (const uint8_t *)std::memchr(p + 1, '\0', end - p - 1);
+                return nul ? nul - p : -1;  // The string and '\0'
+            }
+            case 'B': {
+                if (end - p < 6 || _aux_type_size(p[1]) == 0) return -1;
+                uint32_t n;
+                std::memcpy(&n, p + 2, 4);
+                return 5 + (int64_t)n * _aux_type_size(p[1]);
+            }
+            default: return -1;
+        }
+    }
 
-        if (!_b) return false;
+    int64_t AuxArray::int_at(uint32_t i) const {
+
+        int8_t c; uint8_t uc; int16_t s; uint16_t us; int32_t v; uint32_t uv; float f;
+        switch (type) {
+            case 'c': std::memcpy(&c, data + i, 1); return c;
+            case 'C': std::memcpy(&uc, data + i, 1); return uc;
+            case 's': std::memcpy(&s, data + 2 * i, 2); return s;
+            case 'S': std::memcpy(&us, data + 2 * i, 2); return us;
+            case 'i': std::memcpy(&v, data + 4 * i, 4); return v;
+            case 'I': std::memcpy(&uv, data + 4 * i, 4); return uv;
+            case 'f': std::memcpy(&f, data + 4 * i, 4); return (int64_t)f;
+            default: return 0;
+        }
+    }
 
-        uint8_t *p = bam_aux_get(_b, tag.c_str());
-        return bool(p);
+    double AuxArray::float_at(uint32_t i) const {
+
+        if (type == 'f') {
+            float f;
+            std::memcpy(&f, data + 4 * i, 4);
+            return f;
+        }
+        return (double)int_at(i);
     }
 
-    std::string BamRecord::get_Z_tag(const std::string tag) const {
+    void BamRecord::index_tags() {
+
+        _n_aux = -1;
+        if (!_b) return;
 
-        std::string tag_str;
-        if (has_tag(tag)) {
+        // Index all the tags in one pass.
+        _n_aux = 0;
+        _aux_data = _b->data;
+        _aux_l_data = _b->l_data;
 
-            uint8_t *p = bam_aux_get(_b, tag.c_str());
-            if (*p == 'Z') {
-                char *pp = bam_aux2Z(p);
-                if (pp) {
-                    tag_str = std::string(pp);
-                }
+        const uint8_t *s = bam_get_aux(_b), *end = _b->data + _b->l_data;
+        while (end - s >= 3) {
+            int64_t size = _aux_value_size(s + 2, end);
+            if (size < 0 || size > end - s - 3) break;  // Broken, the rest is not searched as htslib.
+
+            if (_n_aux == AUX_INDEX_SIZE) {  // Too many, scan the aux data by htslib instead.
+                _n_aux = AUX_INDEX_SIZE + 1;
+                break;
             }
-        }
+            _aux_tag[_n_aux] = (uint16_t)(s[0] << 8 | s[1]);
+            _aux_off[_n_aux] = (uint32_t)(s + 2 - _b->data);
+            ++_n_aux;
 
-        return tag_str;
+            s += 3 + size;
+        }
     }
 
-    std::string BamRecord::get_Int_tag(const std::string tag) const {
+    const uint8_t *BamRecord::_aux(const std::string &tag, const char *func) const {
 
-        std::string tag_str;
-        if (has_tag(tag)) {
+        if (!_b) return NULL;
 
-            uint8_t *p = bam_aux_get(_b, tag.c_str());
-            if (*p == 'I' || *p == 'i' ||
-                *p == 'S' || *p == 's' ||
-                *p == 'C' || *p == 'c') {
+        // RGAUX decodes the RG tag only.
+        if (!(_fields & Fields::AUX) && !(tag == "RG" && (_fields & Fields::RGAUX)))
+            _undecoded(Fields::AUX, func);
 
-                tag_str = tostring(bam_aux2i(p));
-            }
+        if (tag.size() != 2) return NULL;
+
+        // No index, or the aux data has been changed since it was built.
+        if (_n_aux < 0 || _n_aux > AUX_INDEX_SIZE || _aux_data != _b->data || _aux_l_data != _b->l_data)
+            return bam_aux_get(_b, tag.c_str());
+
+        uint16_t key = (uint16_t)((uint8_t)tag[0] << 8 | (uint8_t)tag[1]);
+        for (int i = 0; i < _n_aux; ++i) {
+            if (_aux_tag[i] == key) return _b->data + _aux_off[i];
         }
 
-        return tag_str;
+        return NULL;
     }
 
-    std::string BamRecord::get_Float_tag(const std::string tag) const {
+    bool BamRecord::has_tag(const std::string tag) const {
+        return _aux(tag, "has_tag") != NULL;
+    }
+
+    char BamRecord::tag_type(const std::string &tag) const {
+        const uint8_t *p = _aux(tag, "tag_type");
+        return p ? (char)*p : 0;
+    }
 
-        std::string tag_str;
-        if (has_tag(tag)) {
+    bool BamRecord::get_int_tag(const std::string &tag, int64_t &value) const {
 
-            uint8_t *p = bam_aux_get(_b, tag.c_str());
-            if (*p == 'f' || *p == 'd') {
-                tag_str = tostring(bam_aux2f(p));
-            }
+        const uint8_t *p = _aux(tag, "get_int_tag");
+        if (!p) return false;
+
+        switch (*p) {
+            case 'c': case 'C': case 's': case 'S': case 'i': case 'I':
+                value = bam_aux2i(p);
+                return true;
+            default:
+                return false;
         }
+    }
+
+    bool BamRecord::get_float_tag(const std::string &tag, double &value) const {
+
+        const uint8_t *p = _aux(tag, "get_float_tag");
+        if (!p || (*p != 'f' && *p != 'd')) return false;
 
-        return tag_str;
+        value = bam_aux2f(p);
+        return true;
     }
 
-    std::string BamRecord::get_tag(const std::string tag) const {
+    const char *BamRecord::get_string_tag(const std::string &tag) const {
 
-        std::string tag_str;
+        const uint8_t *p = _aux(tag, "get_string_tag");
+        return (p && (*p == 'Z' || *p == 'H')) ? (const char *)(p + 1) : NULL;
+    }
 
-        tag_str = get_Z_tag(tag);
-        if (tag_str.size()) {
-            return tag_str;
-        }
+    bool BamRecord::get_array_tag(const std::string &tag, AuxArray &array) const {
 
-        tag_str = get_Int_tag(tag);
-        if (tag_str.size()) {
-            return tag_str;
-        }
+        const uint8_t *p = _aux(tag, "get_array_tag");
+        if (!p || *p != 'B') return false;
 
-        tag_str = get_Float_tag(tag);
-        if (tag_str.size()) {
-            return tag_str;
-        }
+        array.type = (char)p[1];
+        std::memcpy(&array.n, p + 2, 4);
+        array.data = p + 6;
+        return true;
+    }
+
+    std::string BamRecord::get_Z_tag(const std::string tag) const {
 
-        return tag_str;
+        const uint8_t *p = _aux(tag, "get_Z_tag");
+        return (p && *p == 'Z') ? std::string((const char *)(p + 1)) : std::string();
+    }
+
+    std::string BamRecord::get_Int_tag(const std::string tag) const {
+
+        int64_t value;
+        return get_int_tag(tag, value) ? tostring(value) : std::string();
+    }
+
+    std::string BamRecord::get_Float_tag(const std::string tag) const {
+
+        double value;
+        return get_float_tag(tag, value) ? tostring(value) : std::string();
+    }
+
+    std::string BamRecord::get_tag(const std::string tag) const {
+
+        // One lookup whatever the type is.
+        const uint8_t *p = _aux(tag, "get_tag");
+        if (!p) return "";
+
+        switch (*p) {
+            case 'Z':
+                return std::string((const char *)(p + 1));
+            case 'c': case 'C': case 's': case 'S': case 'i': case 'I':
+                return tostring(bam_aux2i(p));
+            case 'f': case 'd':
+                return tostring(bam_aux2f(p));
+            default:
+                return "";
+        }
     }
 
     std::string BamRecord::read_group() const {
 
         std::string rg;
-        if (has_tag("RG")) {
+        const uint8_t *p = _aux("RG", "read_group");
+        if (p) {
             // try to get from RG tag first
-            rg = get_Z_tag("RG");
+            if (*p == 'Z') rg = (const char *)(p + 1);
 
         } else {
             // try to get the read group tag from qname.
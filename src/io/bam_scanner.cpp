@@ -0,0 +1,124 @@
+#include <stdexcept>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
+#include <htslib/hts.h>
+#include "ngslib/bam_scanner.h"
+#include "ngslib/bam_iterator.h"
+#include "ngslib/index_stats.h"
+#include "ngslib/job_runner.h"
+#include "ngslib/utils.h"
+
+namespace ngslib {
+
+    // The shards (indexes in BamScanner::_shards) owned by one worker. The owner
+    // takes shards from the front and the idle workers steal from the back.
+    struct _ShardQueue {
+        std::mutex lock;
+        std::deque<size_t> shards;
+    };
+
+    struct _WorkQueues {
+        std::vector<_ShardQueue> queues;
+        JobRunner runner;  // Runs the workers, which take shards by take() instead of next_job().
+
+        explicit _WorkQueues(size_t n) : queues(n) {}
+
+        bool take(int worker_id, size_t &shard) {
+
+            size_t n = queues.size();
+            for (size_t k = 0; k < n; ++k) {
+                _ShardQueue &q = queues[(worker_id + k) % n];
+                std::lock_guard<std::mutex> guard(q.lock);
+                if (q.shards.empty()) continue;
+
+                if (k == 0) {  // My own queue
+                    shard = q.shards.front();
+                    q.shards.pop_front();
+                } else {       // Steal from the others
+                    shard = q.shards.back();
+                    q.shards.pop_back();
+                }
+                return true;
+            }
+
+            return false;  // All the queues are empty, no more work.
+        }
+    };
+
+    BamScanner::BamScanner(const std::string &fn, int nthreads, hts_pos_t shard_size,
+                           bool include_unmapped) : _fname(fn), _nthreads(nthreads), _owned_only(true),
+                                                    _bam(fn, "r") {
+
+        if (nthreads <= 0) {
+            throw std::invalid_argument("[bam_scanner.cpp::BamScanner] The number of "
+                                        "threads must be > 0, but got: " + tostring(nthreads));
+        }
+
+        _is_cram = (hts_get_format(_bam.fp())->format == cram);
+        _bam.index_load();  // Load index once, all the BAM workers share it.
+
+        _shards = split_genome(_bam.header(), shard_size);
+        if (!_is_cram && !_shards.empty()) {
+            _shards = split_genome_by_bytes(_bam.idx(), _bam.header(), _shards.size(),
+                                            std::min(shard_size, (hts_pos_t)1000000));
+        }
+        if (include_unmapped) _shards.push_back(GenomeRegion(HTS_IDX_NOCOOR, 0, 0));
+    }
+
+    size_t BamScanner::run(const RecordCallback &callback) {
+
+        if (_shards.empty()) return 0;
+
+        size_t n_worker = std::min((size_t)_nthreads, _shards.size());
+        _WorkQueues work(n_worker);
+
+        // Deal out shards in contiguous blocks.
+        for (size_t i = 0; i < _shards.size(); ++i) {
+            work.queues[i * n_worker / _shards.size()].shards.push_back(i);
+        }
+
+        std::vector<size_t> n_records(n_worker, 0);
+        work.runner.run(n_worker, [this, &work, &callback, &n_records](int i) {
+            this->_scan(i, work, callback, n_records[i]);
+        });
+
+        size_t total = 0;
+        for (size_t i = 0; i < n_worker; ++i) total += n_records[i];
+
+        return total;
+    }
+
+    void BamScanner::_scan(int worker_id, _WorkQueues &work, const RecordCallback &callback,
+                           size_t &n_record) {
+
+        // Private file handle and header for each worker.
+        Bam bam(_fname, "r");
+        hts_idx_t *idx = _is_cram ? bam.idx() : _bam.idx();
+
+        BamRecord br;
+        size_t i;
+        while (!work.runner.aborted() && work.take(worker_id, i)) {
+
+            const GenomeRegion &shard = _shards[i];
+            BamIterator it(bam.fp(), idx, bam.header().h(), shard.to_string(_bam.header()));
+
+            int io_status = 0;
+            while (!work.runner.aborted() && (io_status = it.next(br)) >= 0) {
+                // Owned by the previous shard, only the start position is checked.
+                if (_owned_only && shard.tid >= 0 && br.b()->core.pos < shard.beg) continue;
+
+                callback(shard, br, worker_id);
+                ++n_record;
+            }
+
+            if (io_status < -1) {
+                throw std::invalid_argument("[bam_scanner.cpp::BamScanner:run] Fail to read "
+                                            "data in " + shard.to_string(_bam.header()) +
+                                            " of " + _fname);
+            }
+        }
+    }
+
+}  // namespace ngslib
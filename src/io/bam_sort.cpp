@@ -0,0 +1,344 @@
+#include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include <htslib/sam.h>
+#include "ngslib/bam_sort.h"
+#include "ngslib/bam.h"
+#include "ngslib/bam_record.h"
+#include "ngslib/bam_writer.h"
+#include "ngslib/multi_bam.h"
+#include "ngslib/thread_pool.h"
+#include "ngslib/utils.h"
+
+namespace ngslib {
+
+    // A record packed in the arena: the core, the length of data and the data.
+    struct _PackedRecord {
+        bam1_core_t core;
+        int32_t l_data;
+    };
+
+    // The data of a packed record starts at 8-byte boundary, so is the next record.
+    static const size_t PACKED_HEAD = (sizeof(_PackedRecord) + 7) & ~(size_t)7;
+
+    // A record to sort, the keys are (tid, pos << 1 | strand) for coordinate
+    // order. Records are packed in input order, so `rec` breaks the ties.
+    struct _SortEntry {
+        uint64_t k1, k2;
+        const uint8_t *rec;
+    };
+
+    int strnum_cmp(const char *a, const char *b) {
+
+        const unsigned char *pa = (const unsigned char *)a, *pb = (const unsigned char *)b;
+        while (*pa && *pb) {
+            if (!isdigit(*pa) || !isdigit(*pb)) {
+                if (*pa != *pb) return (int)*pa - (int)*pb;
+                ++pa;
+                ++pb;
+                continue;
+            }
+
+            // Compare the numbers by value: skip the leading zeros and the
+            // same digits, the longer number is larger, or the first different
+            // digit tells.
+            while (*pa == '0') ++pa;
+            while (*pb == '0') ++pb;
+            while (isdigit(*pa) && *pa == *pb) {
+                ++pa;
+                ++pb;
+            }
+
+            int diff = (int)*pa - (int)*pb;
+            while (isdigit(*pa) && isdigit(*pb)) {
+                ++pa;
+                ++pb;
+            }
+
+            if (isdigit(*pa)) return 1;
+            if (isdigit(*pb)) return -1;
+            if (diff) return diff;
+        }
+
+        return *pa ? 1 : (*pb ? -1 : 0);
+    }
+
+    bool coordinate_less(const bam1_t *a, const bam1_t *b) {
+
+        uint32_t ta = a->core.tid, tb = b->core.tid;
+        if (ta != tb) return ta < tb;
+        if (a->core.pos != b->core.pos) return a->core.pos < b->core.pos;
+        return bam_is_rev(a) < bam_is_rev(b);
+    }
+
+    // Read names, then READ1 before READ2.
+    static int _queryname_cmp(const char *qa, uint16_t fa, const char *qb, uint16_t fb) {
+
+        int c = strnum_cmp(qa, qb);
+        if (c) return c;
+        return (int)(fa & (BAM_FREAD1 | BAM_FREAD2)) - (int)(fb & (BAM_FREAD1 | BAM_FREAD2));
+    }
+
+    bool queryname_less(const bam1_t *a, const bam1_t *b) {
+        return _queryname_cmp(bam_get_qname(a), a->core.flag, bam_get_qname(b), b->core.flag) < 0;
+    }
+
+    static bool _entry_coordinate_less(const _SortEntry &a, const _SortEntry &b) {
+
+        if (a.k1 != b.k1) return a.k1 < b.k1;
+        if (a.k2 != b.k2) return a.k2 < b.k2;
+        return a.rec < b.rec;
+    }
+
+    static bool _entry_queryname_less(const _SortEntry &a, const _SortEntry &b) {
+
+        const _PackedRecord *pa = (const _PackedRecord *)a.rec, *pb = (const _PackedRecord *)b.rec;
+        int c = _queryname_cmp((const char *)a.rec + PACKED_HEAD, pa->core.flag,
+                               (const char *)b.rec + PACKED_HEAD, pb->core.flag);
+        return c ? c < 0 : a.rec < b.rec;
+    }
+
+    // Make `b` a read-only view of a packed record, no copy.
+    static void _view(const uint8_t *rec, bam1_t *b) {
+
+        const _PackedRecord *p = (const _PackedRecord *)rec;
+        b->core = p->core;
+        b->l_data = p->l_data;
+        b->m_data = p->l_data;
+        b->data = const_cast<uint8_t *>(rec) + PACKED_HEAD;
+    }
+
+    /* Sort `v` by `nthreads` threads: each thread sorts a chunk, then the
+     * sorted chunks are merged pairwise in parallel into `tmp` and back, until
+     * one is left. */
+    static void _parallel_sort(std::vector<_SortEntry> &v, std::vector<_SortEntry> &tmp, int nthreads,
+                               bool (*less)(const _SortEntry &, const _SortEntry &)) {
+
+        size_t n = v.size();
+        size_t k = std::min((size_t)nthreads, n / 65536 + 1);  // Not worth a thread for small chunks.
+        if (k <= 1) {
+            std::sort(v.begin(), v.end(), less);
+            return;
+        }
+
+        std::vector<size_t> bounds(k + 1);
+        for (size_t i = 0; i <= k; ++i) bounds[i] = n * i / k;
+
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < k; ++i) {
+            workers.push_back(std::thread([&v, &bounds, less, i]() {
+                std::sort(v.begin() + bounds[i], v.begin() + bounds[i + 1], less);
+            }));
+        }
+        for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+
+        tmp.resize(n);
+        while (bounds.size() > 2) {
+
+            workers.clear();
+            std::vector<size_t> merged(1, 0);
+            for (size_t i = 0; i + 1 < bounds.size(); i += 2) {
+                size_t beg = bounds[i], mid = bounds[i + 1];
+                size_t end = i + 2 < bounds.size() ? bounds[i + 2] : mid;  // The odd one is copied.
+                workers.push_back(std::thread([&v, &tmp, less, beg, mid, end]() {
+                    std::merge(v.begin() + beg, v.begin() + mid, v.begin() + mid, v.begin() + end,
+                               tmp.begin() + beg, less);
+                }));
+                merged.push_back(end);
+            }
+            for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+
+            v.swap(tmp);
+            bounds.swap(merged);
+        }
+    }
+
+    BamSorter::BamSorter(const std::string &fn, int order) : _fname(fn), _order(order),
+                                                              _max_memory((size_t)768 << 20), _nthreads(1),
+                                                              _index(false), _min_shift(0), _max_open(256),
+                                                              _n_records(0) {
+
+        if (order != SortOrder::COORDINATE && order != SortOrder::QUERYNAME) {
+            throw std::invalid_argument("[bam_sort.cpp::BamSorter] Unknown sort order: " + tostring(order));
+        }
+    }
+
+    BamSorter::~BamSorter() {
+        for (size_t i = 0; i < _runs.size(); ++i) std::remove(_runs[i].c_str());
+    }
+
+    void BamSorter::set_max_memory(size_t bytes) {
+
+        if (bytes < ((size_t)1 << 20)) {
+            throw std::invalid_argument("[bam_sort.cpp::BamSorter:set_max_memory] At least 1Mb memory "
+                                        "is required, but got: " + tostring(bytes));
+        }
+        _max_memory = bytes;
+    }
+
+    void BamSorter::set_threads(int nthreads) {
+
+        if (nthreads <= 0) {
+            throw std::invalid_argument("[bam_sort.cpp::BamSorter:set_threads] The number of threads "
+                                        "must be > 0, but got: " + tostring(nthreads));
+        }
+        _nthreads = nthreads;
+    }
+
+    void BamSorter::set_index(bool index, int min_shift) {
+
+        if (index && _order != SortOrder::COORDINATE) {
+            throw std::invalid_argument("[bam_sort.cpp::BamSorter:set_index] Only the file sorted by "
+                                        "coordinate could be indexed.");
+        }
+        _index = index;
+        _min_shift = min_shift;
+    }
+
+    // Write the sorted records to a temporary BAM with fast compression.
+    static void _write_run(const std::vector<_SortEntry> &entries, const std::string &fn,
+                           const BamHeader &hdr, const SharedThreadPool &tp) {
+
+        samFile *fp = sam_open(fn.c_str(), "wb1");
+        if (!fp) {
+            throw std::invalid_argument("[bam_sort.cpp::BamSorter] Fail to create temporary file " + fn);
+        }
+
+        bool ok = tp->attach(fp) == 0 && sam_hdr_write(fp, hdr.h()) >= 0;
+        bam1_t b;
+        std::memset(&b, 0, sizeof(b));
+        for (size_t i = 0; ok && i < entries.size(); ++i) {
+            _view(entries[i].rec, &b);
+            ok = sam_write1(fp, hdr.h(), &b) >= 0;
+        }
+
+        if (sam_close(fp) < 0 || !ok) {
+            throw std::invalid_argument("[bam_sort.cpp::BamSorter] Fail to write temporary file " + fn);
+        }
+    }
+
+    size_t BamSorter::run(const std::string &out_fn, const std::string &mode) {
+
+        for (size_t i = 0; i < _runs.size(); ++i) std::remove(_runs[i].c_str());
+        _runs.clear();
+        _n_records = 0;
+
+        // One pool for decompressing input and runs, and compressing runs and output.
+        SharedThreadPool tp = make_thread_pool(_nthreads);
+        Bam in(_fname, "r", tp);
+
+        BamHeader hdr = in.header();
+        if (sam_hdr_change_HD(hdr.h(), "SO", _order == SortOrder::COORDINATE ? "coordinate" : "queryname") < 0) {
+            throw std::invalid_argument("[bam_sort.cpp::BamSorter:run] Fail to update the header.");
+        }
+
+        std::string prefix = _tmp_prefix.empty() ? out_fn + ".tmp" : _tmp_prefix;
+        bool (*less)(const _SortEntry &, const _SortEntry &) = _order == SortOrder::COORDINATE
+                                                               ? _entry_coordinate_less
+                                                               : _entry_queryname_less;
+
+        // The arena is not touched beyond what has been used, and the entries
+        // (and the buffer to merge them) are counted in the memory budget too.
+        std::unique_ptr<uint8_t[]> arena(new uint8_t[_max_memory]);
+        size_t used = 0;
+        std::vector<_SortEntry> entries, tmp;
+
+        BamRecord br;
+        int ret;
+        while ((ret = in.read(br)) >= 0) {
+
+            const bam1_t *b = br.b();
+            size_t size = PACKED_HEAD + (((size_t)b->l_data + 7) & ~(size_t)7);
+            // The entries (the vector doubles when it's full) and the merging buffer.
+            size_t n = entries.size() + 1;
+            size_t cap = entries.capacity() < n ? std::max(entries.capacity() * 2, n) : entries.capacity();
+            size_t index_size = (cap + n) * sizeof(_SortEntry);
+            if (used + size + index_size > _max_memory && !entries.empty()) {
+                _parallel_sort(entries, tmp, _nthreads, less);
+                _runs.push_back(prefix + "." + tostring(_runs.size()) + ".bam");
+                _write_run(entries, _runs.back(), hdr, tp);
+
+                entries.clear();
+                std::vector<_SortEntry>().swap(tmp);
+                used = 0;
+            }
+
+            if (size > _max_memory) {
+                throw std::invalid_argument("[bam_sort.cpp::BamSorter:run] The record is too large for "
+                                            "the memory: " + br.qname());
+            }
+
+            uint8_t *rec = arena.get() + used;
+            _PackedRecord *p = (_PackedRecord *)rec;
+            p->core = b->core;
+            p->l_data = b->l_data;
+            std::memcpy(rec + PACKED_HEAD, b->data, b->l_data);
+            used += size;
+
+            _SortEntry e;
+            e.k1 = (uint32_t)b->core.tid;
+            e.k2 = ((uint64_t)(b->core.pos + 1) << 1) | (bam_is_rev(b) ? 1 : 0);
+            e.rec = rec;
+            entries.push_back(e);
+            ++_n_records;
+        }
+
+        if (ret < -1) {
+            throw std::invalid_argument("[bam_sort.cpp::BamSorter:run] Fail to read " + _fname);
+        }
+
+        _parallel_sort(entries, tmp, _nthreads, less);
+        std::vector<_SortEntry>().swap(tmp);
+
+        BamWriter out(out_fn, hdr, mode, tp);
+        if (!_reference.empty()) out.set_reference(_reference);
+        if (_index) out.set_index(_min_shift);
+
+        if (_runs.empty()) {
+            // All in memory, no temporary file.
+            bam1_t b;
+            std::memset(&b, 0, sizeof(b));
+            for (size_t i = 0; i < entries.size(); ++i) {
+                _view(entries[i].rec, &b);
+                out.write(&b);
+            }
+
+        } else {
+            _runs.push_back(prefix + "." + tostring(_runs.size()) + ".bam");
+            _write_run(entries, _runs.back(), hdr, tp);
+            entries.clear();
+            arena.reset();  // Free the memory for merging.
+
+            MultiBam runs(_runs, _max_open);
+            runs.set_order(_order);
+            runs.set_thread_pool(tp);
+
+            while ((ret = runs.read(br)) >= 0) {
+                out.write(br);
+            }
+            if (ret < -1) {
+                throw std::invalid_argument("[bam_sort.cpp::BamSorter:run] Fail to read temporary files.");
+            }
+        }
+
+        if (out.close() < 0) {
+            throw std::invalid_argument("[bam_sort.cpp::BamSorter:run] Fail to write " + out_fn);
+        }
+
+        for (size_t i = 0; i < _runs.size(); ++i) std::remove(_runs[i].c_str());
+        return _n_records;
+    }
+
+    size_t sort(const std::string &in_fn, const std::string &out_fn, int order, size_t max_memory, int nthreads) {
+
+        BamSorter sorter(in_fn, order);
+        sorter.set_max_memory(max_memory);
+        sorter.set_threads(nthreads);
+        return sorter.run(out_fn);
+    }
+
+}  // namespace ngslib
@@ -0,0 +1,227 @@
+#include <stdexcept>
+
+#include <htslib/hts.h>
+#include "ngslib/bam_writer.h"
+#include "ngslib/index_cache.h"
+#include "ngslib/utils.h"
+
+namespace ngslib {
+
+    struct _WriteBuffer {
+        std::vector<bam1_t *> records;  // Allocated bam1_t, reused batch after batch.
+        size_t n;                       // The number of records in use.
+
+        _WriteBuffer() : n(0) {}
+        ~_WriteBuffer() {
+            for (size_t i = 0; i < records.size(); ++i) bam_destroy1(records[i]);
+        }
+    };
+
+    BamWriter::BamWriter(const std::string &fn, const BamHeader &hdr, const std::string &mode,
+                         int nthreads) : _fp(NULL), _header_written(false), _index(false),
+                                         _min_shift(0), _batch_size(4096),
+                                         _queue_depth(4), _batch(NULL), _stop(false), _io_status(0) {
+        _open(fn, mode, hdr, nthreads > 0 ? make_thread_pool(nthreads) : SharedThreadPool());
+    }
+
+    BamWriter::BamWriter(const std::string &fn, const BamHeader &hdr, const std::string &mode,
+                         const SharedThreadPool &tp) : _fp(NULL), _header_written(false),
+                                                       _index(false), _min_shift(0), _batch_size(4096),
+                                                       _queue_depth(4), _batch(NULL), _stop(false),
+                                                       _io_status(0) {
+        if (!tp) {
+            throw std::invalid_argument("[bam_writer.cpp::BamWriter] The thread pool is NULL.");
+        }
+        _open(fn, mode, hdr, tp);
+    }
+
+    void BamWriter::_open(const std::string &fn, const std::string &mode, const BamHeader &hdr,
+                          const SharedThreadPool &tp) {
+
+        _fname = fn;
+        _mode = mode;
+
+        if (mode.empty() || mode[0] != 'w') {
+            throw std::invalid_argument("[bam_writer.cpp::BamWriter:_open] mode must "
+                                        "start with 'w', but got: " + mode);
+        }
+
+        if (!hdr) {
+            throw std::invalid_argument("[bam_writer.cpp::BamWriter:_open] The header is empty.");
+        }
+
+        _fp = sam_open(fn.c_str(), mode.c_str());
+        if (!_fp) {
+            throw std::invalid_argument("[bam_writer.cpp::BamWriter:_open] file open failure - " + fn);
+        }
+
+        if (tp) {
+            if (tp->attach(_fp) != 0) {
+                sam_close(_fp);
+                _fp = NULL;
+                throw std::invalid_argument("[bam_writer.cpp::BamWriter:_open] Fail to attach "
+                                            "the thread pool to " + fn);
+            }
+            _tpool = tp;
+        }
+
+        _hdr = hdr;
+        _batch = new _WriteBuffer;
+    }
+
+    void BamWriter::set_reference(const std::string &fa) {
+
+        if (_header_written || hts_set_fai_filename(_fp, fa.c_str()) != 0) {
+            throw std::invalid_argument("[bam_writer.cpp::BamWriter:set_reference] Fail to "
+                                        "set reference " + fa + " for " + _fname);
+        }
+    }
+
+    void BamWriter::set_buffer(size_t batch_size, size_t queue_depth) {
+
+        if (_header_written || batch_size == 0 || queue_depth == 0) {
+            throw std::invalid_argument("[bam_writer.cpp::BamWriter:set_buffer] batch_size "
+                                        "and queue_depth must be > 0, and could only be set "
+                                        "before writing any record.");
+        }
+
+        _batch_size = batch_size;
+        _queue_depth = queue_depth;
+    }
+
+    void BamWriter::set_index(int min_shift, const std::string &fnidx) {
+
+        if (!_fp || _header_written || min_shift < 0) {
+            throw std::invalid_argument("[bam_writer.cpp::BamWriter:set_index] min_shift must be "
+                                        ">= 0, and index could only be set before writing any record.");
+        }
+
+        _index = true;
+        _min_shift = min_shift;
+        _fnidx = fnidx;
+        if (_fnidx.empty()) {
+            if (hts_get_format(_fp)->format == cram) {
+                _fnidx = _fname + ".crai";
+            } else {
+                _fnidx = _fname + (min_shift > 0 ? ".csi" : ".bai");
+            }
+        }
+    }
+
+    void BamWriter::_start() {
+
+        _header_written = true;
+        if (sam_hdr_write(_fp, _hdr.h()) < 0) {
+            _io_status = -1;
+            return;
+        }
+
+        // The index must be initialized between the header and the first record.
+        if (_index && sam_idx_init(_fp, _hdr.h(), _min_shift, _fnidx.c_str()) < 0) {
+            _io_status = -1;
+            return;
+        }
+
+        _writer = std::thread(&BamWriter::_write_loop, this);
+    }
+
+    int BamWriter::write(const BamRecord &br) {
+        return write(br.b());
+    }
+
+    int BamWriter::write(const bam1_t *rec) {
+
+        if (!rec || !_fp) return -1;
+        if (!_header_written) _start();
+        if (_io_status < 0) return -1;
+
+        _WriteBuffer *b = _batch;
+        if (b->n == b->records.size()) b->records.push_back(bam_init1());
+
+        // Reuse the memory of bam1_t in the batch.
+        if (!bam_copy1(b->records[b->n], rec)) {
+            _io_status = -1;
+            return -1;
+        }
+
+        if (++b->n >= _batch_size) _submit();
+        return 0;
+    }
+
+    void BamWriter::_submit() {
+
+        std::unique_lock<std::mutex> lock(_lock);
+        while (_queue.size() >= _queue_depth) _not_full.wait(lock);
+
+        _queue.push_back(_batch);
+        _not_empty.notify_one();
+
+        if (_recycle.empty()) {
+            _batch = new _WriteBuffer;
+        } else {
+            _batch = _recycle.back();
+            _recycle.pop_back();
+        }
+        _batch->n = 0;
+    }
+
+    void BamWriter::_write_loop() {
+
+        while (true) {
+            _WriteBuffer *b;
+            {
+                std::unique_lock<std::mutex> lock(_lock);
+                while (_queue.empty() && !_stop) _not_empty.wait(lock);
+                if (_queue.empty()) break;  // _stop and nothing left.
+
+                b = _queue.front();
+                _queue.pop_front();
+                _not_full.notify_one();
+            }
+
+            for (size_t i = 0; i < b->n && _io_status >= 0; ++i) {
+                if (sam_write1(_fp, _hdr.h(), b->records[i]) < 0) _io_status = -1;
+            }
+
+            std::lock_guard<std::mutex> lock(_lock);
+            _recycle.push_back(b);
+        }
+    }
+
+    int BamWriter::close() {
+
+        if (!_fp) return _io_status;
+
+        if (!_header_written) _start();  // An empty file still has the header.
+        if (_writer.joinable()) {
+            if (_batch->n > 0) _submit();
+
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+                _stop = true;
+            }
+            _not_empty.notify_one();
+            _writer.join();
+        }
+
+        if (_index) {
+            if (_io_status >= 0 && sam_idx_save(_fp) < 0) _io_status = -1;
+            IndexCache::instance().drop(_fname);  // An index of the old file may be cached.
+        }
+        if (sam_close(_fp) < 0) _io_status = -1;
+        _fp = NULL;
+
+        delete _batch;
+        _batch = NULL;
+        for (size_t i = 0; i < _recycle.size(); ++i) delete _recycle[i];
+        _recycle.clear();
+
+        return _io_status;
+    }
+
+    std::ostream &operator<<(std::ostream &os, const BamWriter &w) {
+        os << w._fname;
+        return os;
+    }
+
+}  // namespace ngslib
@@ -0,0 +1,28 @@
+#include "ngslib/cigar_view.h"
+
+namespace ngslib {
+
+    std::string CigarView::to_string() const {
+
+        if (_n == 0) return "*";
+
+        std::string s;
+        s.reserve(_n * 4);
+
+        char digits[10];
+        for (uint32_t i = 0; i < _n; ++i) {
+            uint32_t len = bam_cigar_oplen(_c[i]);
+            int k = 0;
+            do {
+                digits[k++] = '0' + len % 10;
+                len /= 10;
+            } while (len);
+
+            while (k) s += digits[--k];
+            s += bam_cigar_opchr(_c[i]);
+        }
+
+        return s;
+    }
+
+}  // namespace ngslib
@@ -0,0 +1,368 @@
+#include <stdexcept>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <htslib/sam.h>
+#include "ngslib/column_batch.h"
+
+namespace ngslib {
+
+    void Selection::resize(size_t n, bool value) {
+
+        size_t old_n = _n, old_nw = _bits.size();
+        _bits.resize((n + 63) >> 6, value ? ~(uint64_t)0 : 0);
+        _n = n;
+
+        // The tail of the last old word.
+        for (size_t i = old_n; value && i < n && (i >> 6) < old_nw; ++i) set(i);
+        if (n & 63) _bits.back() &= ((uint64_t)1 << (n & 63)) - 1;
+    }
+
+    size_t Selection::count() const {
+        size_t c = 0;
+        for (size_t i = 0; i < _bits.size(); ++i)
+            c += __builtin_popcountll(_bits[i]);
+
+        return c;
+    }
+
+    Selection &Selection::operator&=(const Selection &s) {
+        if (s._n != _n)
+            throw std::invalid_argument("[column_batch.cpp::Selection:operator&=] The sizes are different.");
+
+        for (size_t i = 0; i < _bits.size(); ++i) _bits[i] &= s._bits[i];
+        return *this;
+    }
+
+    Selection &Selection::operator|=(const Selection &s) {
+        if (s._n != _n)
+            throw std::invalid_argument("[column_batch.cpp::Selection:operator|=] The sizes are different.");
+
+        for (size_t i = 0; i < _bits.size(); ++i) _bits[i] |= s._bits[i];
+        return *this;
+    }
+
+    void Selection::flip() {
+        for (size_t i = 0; i < _bits.size(); ++i) _bits[i] = ~_bits[i];
+        if (_n & 63) _bits.back() &= ((uint64_t)1 << (_n & 63)) - 1;
+    }
+
+    void ColumnBatch::set_payload(int payload) {
+        if (!empty())
+            throw std::invalid_argument("[column_batch.cpp::ColumnBatch:set_payload] The batch is not empty.");
+
+        _payload = payload & ColumnPayload::ALL;
+    }
+
+    void ColumnBatch::reserve(size_t n) {
+        _tid.reserve(n);
+        _pos.reserve(n);
+        _mtid.reserve(n);
+        _mpos.reserve(n);
+        _isize.reserve(n);
+        _flag.reserve(n);
+        _mapq.reserve(n);
+        _l_qseq.reserve(n);
+        _off.reserve(n + 1);
+    }
+
+    void ColumnBatch::append(const bam1_t *b) {
+
+        if (!b)
+            throw std::invalid_argument("[column_batch.cpp::ColumnBatch:append] NULL record.");
+
+        const bam1_core_t &c = b->core;
+        _tid.push_back(c.tid);
+        _pos.push_back(c.pos);
+        _mtid.push_back(c.mtid);
+        _mpos.push_back(c.mpos);
+        _isize.push_back(c.isize);
+        _flag.push_back(c.flag);
+        _mapq.push_back(c.qual);
+        _l_qseq.push_back(c.l_qseq);
+
+        if (_payload & ColumnPayload::SEQ) {
+            const uint8_t *s = bam_get_seq(b);
+            _blob.insert(_blob.end(), s, s + ((c.l_qseq + 1) >> 1));
+        }
+        if (_payload & ColumnPayload::QUAL) {
+            const uint8_t *q = bam_get_qual(b);
+            _blob.insert(_blob.end(), q, q + c.l_qseq);
+        }
+        if (_payload & ColumnPayload::AUX) {
+            const uint8_t *a = bam_get_aux(b);
+            _blob.insert(_blob.end(), a, a + bam_get_l_aux(b));
+        }
+        _off.push_back(_blob.size());
+    }
+
+    void ColumnBatch::clear() {
+        _tid.clear();
+        _pos.clear();
+        _mtid.clear();
+        _mpos.clear();
+        _isize.clear();
+        _flag.clear();
+        _mapq.clear();
+        _l_qseq.clear();
+        _blob.clear();
+        _off.resize(1);
+    }
+
+    const uint8_t *ColumnBatch::seq(size_t i) const {
+        return (_payload & ColumnPayload::SEQ) ? _blob.data() + _off[i] : NULL;
+    }
+
+    const uint8_t *ColumnBatch::qual(size_t i) const {
+        if (!(_payload & ColumnPayload::QUAL)) return NULL;
+        size_t off = _off[i] + ((_payload & ColumnPayload::SEQ) ? (_l_qseq[i] + 1) >> 1 : 0);
+
+        return _blob.data() + off;
+    }
+
+    const uint8_t *ColumnBatch::aux(size_t i) const {
+        return (_payload & ColumnPayload::AUX) ? _blob.data() + _off[i + 1] - aux_len(i) : NULL;
+    }
+
+    size_t ColumnBatch::aux_len(size_t i) const {
+        if (!(_payload & ColumnPayload::AUX)) return 0;
+
+        size_t n = _off[i + 1] - _off[i];
+        if (_payload & ColumnPayload::SEQ) n -= (_l_qseq[i] + 1) >> 1;
+        if (_payload & ColumnPayload::QUAL) n -= _l_qseq[i];
+
+        return n;
+    }
+
+    // Resize `sel` to `n` records, all unselected.
+    static uint64_t *_reset(std::vector<uint64_t> &bits, size_t &sel_n, size_t n) {
+        bits.assign((n + 63) >> 6, 0);
+        sel_n = n;
+
+        return bits.data();
+    }
+
+    void ColumnBatch::select(const ReadFilter &filter, Selection &sel) const {
+
+        size_t n = size();
+        uint64_t *w = _reset(sel._bits, sel._n, n);
+        const uint16_t *flag = _flag.data();
+        const uint8_t *mapq = _mapq.data();
+
+        size_t i = 0;
+#ifdef __SSE2__
+        // 8 FLAGs at a time, the bits of a block never cross a word as 64 % 8 == 0.
+        __m128i req = _mm_set1_epi16((short)filter.require_flags);
+        __m128i exc = _mm_set1_epi16((short)filter.exclude_flags);
+        __m128i zero = _mm_setzero_si128();
+        for (; i + 8 <= n; i += 8) {
+            __m128i f = _mm_loadu_si128((const __m128i *)(flag + i));
+            __m128i m = _mm_and_si128(_mm_cmpeq_epi16(_mm_and_si128(f, req), req),
+                                      _mm_cmpeq_epi16(_mm_and_si128(f, exc), zero));
+            w[i >> 6] |= (uint64_t)_mm_movemask_epi8(_mm_packs_epi16(m, zero)) << (i & 63);
+        }
+#endif
+        for (; i < n; ++i) {
+            uint64_t pass = ((flag[i] & filter.require_flags) == filter.require_flags) &&
+                            ((flag[i] & filter.exclude_flags) == 0);
+            w[i >> 6] |= pass << (i & 63);
+        }
+
+        if (filter.min_mapq <= 0) return;
+        if (filter.min_mapq > 255) {
+            for (size_t k = 0; k < sel._bits.size(); ++k) w[k] = 0;
+            return;
+        }
+
+        i = 0;
+#ifdef __SSE2__
+        // 16 MAPQs at a time: mapq >= min_mapq if max(mapq, min_mapq) == mapq.
+        __m128i mq = _mm_set1_epi8((char)filter.min_mapq);
+        for (; i + 16 <= n; i += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(mapq + i));
+            uint64_t fail = ~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(x, mq), x)) & 0xFFFF;
+            w[i >> 6] &= ~(fail << (i & 63));
+        }
+#endif
+        for (; i < n; ++i) {
+            uint64_t fail = mapq[i] < filter.min_mapq;
+            w[i >> 6] &= ~(fail << (i & 63));
+        }
+    }
+
+    // The bitmaps of up to 64 records, bit i is for record i.
+
+    // Bit i of bits[b] is set if bit b of flag[i] is set, for the 12 bits of
+    // FLAG (BAM_FPAIRED ~ BAM_FSUPPLEMENTARY).
+    static const int _N_FLAG_BITS = 12;
+    static void _flag_bits(const uint16_t *flag, size_t n, uint64_t bits[_N_FLAG_BITS]) {
+
+        for (int b = 0; b < _N_FLAG_BITS; ++b) bits[b] = 0;
+
+        size_t i = 0;
+#ifdef __SSE2__
+        // 16 FLAGs at a time: shift bit b up to the sign bit of each lane, the
+        // signed saturation of _mm_packs_epi16() keeps it for _mm_movemask_epi8().
+        for (; i + 16 <= n; i += 16) {
+            __m128i lo = _mm_loadu_si128((const __m128i *)(flag + i));
+            __m128i hi = _mm_loadu_si128((const __m128i *)(flag + i + 8));
+            for (int b = 0; b < _N_FLAG_BITS; ++b) {
+                __m128i sh = _mm_cvtsi32_si128(15 - b);
+                __m128i m = _mm_packs_epi16(_mm_sll_epi16(lo, sh), _mm_sll_epi16(hi, sh));
+                bits[b] |= (uint64_t)_mm_movemask_epi8(m) << i;
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            for (int b = 0; b < _N_FLAG_BITS; ++b)
+                bits[b] |= (uint64_t)((flag[i] >> b) & 1) << i;
+        }
+    }
+
+    static inline uint64_t _flag_bit(const uint64_t bits[_N_FLAG_BITS], int flag) {
+        return bits[__builtin_ctz(flag)];
+    }
+
+    // The records with x[i] == v.
+    static uint64_t _equal_bits(const int32_t *x, size_t n, int32_t v) {
+
+        uint64_t bits = 0;
+        size_t i = 0;
+#ifdef __SSE2__
+        __m128i vv = _mm_set1_epi32(v);
+        for (; i + 4 <= n; i += 4) {
+            __m128i m = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *)(x + i)), vv);
+            bits |= (uint64_t)_mm_movemask_ps(_mm_castsi128_ps(m)) << i;
+        }
+#endif
+        for (; i < n; ++i) bits |= (uint64_t)(x[i] == v) << i;
+        return bits;
+    }
+
+#ifdef __SSE2__
+    // a > b of the signed 64-bit lanes. SSE2 has no 64-bit compare: compare the
+    // high halves signed and the low halves unsigned, then combine them.
+    static inline __m128i _cmpgt_epi64(__m128i a, __m128i b) {
+        __m128i flip = _mm_set_epi32(0, (int)0x80000000, 0, (int)0x80000000);  // The low halves.
+        __m128i gt = _mm_cmpgt_epi32(_mm_xor_si128(a, flip), _mm_xor_si128(b, flip));
+        __m128i eq = _mm_cmpeq_epi32(a, b);
+
+        __m128i gt_hi = _mm_shuffle_epi32(gt, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128i gt_lo = _mm_shuffle_epi32(gt, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128i eq_hi = _mm_shuffle_epi32(eq, _MM_SHUFFLE(3, 3, 1, 1));
+        return _mm_or_si128(gt_hi, _mm_and_si128(eq_hi, gt_lo));
+    }
+#endif
+
+    // The records with lo <= x[i] <= hi, or lo <= |x[i]| <= hi if `absolute`.
+    static uint64_t _range_bits(const hts_pos_t *x, size_t n, hts_pos_t lo, hts_pos_t hi, bool absolute) {
+
+        uint64_t bits = 0;
+        size_t i = 0;
+#ifdef __SSE2__
+        __m128i vlo = _mm_set1_epi64x(lo), vhi = _mm_set1_epi64x(hi);
+        for (; i + 2 <= n; i += 2) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(x + i));
+            if (absolute) {  // (v ^ s) - s, s is all ones for v < 0.
+                __m128i s = _mm_srai_epi32(_mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 1, 1)), 31);
+                v = _mm_sub_epi64(_mm_xor_si128(v, s), s);
+            }
+            __m128i fail = _mm_or_si128(_cmpgt_epi64(vlo, v), _cmpgt_epi64(v, vhi));
+            bits |= (uint64_t)(~_mm_movemask_pd(_mm_castsi128_pd(fail)) & 3) << i;
+        }
+#endif
+        for (; i < n; ++i) {
+            hts_pos_t v = (absolute && x[i] < 0) ? -x[i] : x[i];
+            bits |= (uint64_t)((v >= lo) & (v <= hi)) << i;
+        }
+        return bits;
+    }
+
+    void ColumnBatch::select_tid(int32_t tid, Selection &sel, hts_pos_t beg, hts_pos_t end) const {
+
+        size_t n = size();
+        uint64_t *w = _reset(sel._bits, sel._n, n);
+        bool all = end <= beg;
+        for (size_t k = 0, i = 0; i < n; ++k, i += 64) {
+            size_t m = n - i < 64 ? n - i : 64;
+            w[k] = _equal_bits(&_tid[i], m, tid);
+            if (!all && w[k]) w[k] &= _range_bits(&_pos[i], m, beg, end - 1, false);
+        }
+    }
+
+    void ColumnBatch::select_insert_size(hts_pos_t min_isize, hts_pos_t max_isize, Selection &sel) const {
+
+        size_t n = size();
+        uint64_t *w = _reset(sel._bits, sel._n, n);
+        for (size_t k = 0, i = 0; i < n; ++k, i += 64) {
+            size_t m = n - i < 64 ? n - i : 64;
+            w[k] = _range_bits(&_isize[i], m, min_isize, max_isize, true);
+        }
+    }
+
+    void ColumnBatch::flag_stat(FlagStat &st, const Selection *sel) const {
+
+        if (sel && sel->size() != size())
+            throw std::invalid_argument("[column_batch.cpp::ColumnBatch:flag_stat] The size of "
+                                        "selection is different from the batch.");
+
+        // Count by bitmaps of 64 records: one popcount per FLAG bit per word.
+        size_t n = size();
+        uint64_t fb[_N_FLAG_BITS];
+        for (size_t k = 0, i = 0; i < n; ++k, i += 64) {
+            size_t m = n - i < 64 ? n - i : 64;
+            uint64_t s = sel ? sel->_bits[k] : (m == 64 ? ~(uint64_t)0 : ((uint64_t)1 << m) - 1);
+            if (!s) continue;
+
+            _flag_bits(&_flag[i], m, fb);
+            uint64_t unmap = _flag_bit(fb, BAM_FUNMAP);
+
+            st.total += __builtin_popcountll(s);
+            st.qc_fail += __builtin_popcountll(s & _flag_bit(fb, BAM_FQCFAIL));
+            st.secondary += __builtin_popcountll(s & _flag_bit(fb, BAM_FSECONDARY));
+            st.supplementary += __builtin_popcountll(s & _flag_bit(fb, BAM_FSUPPLEMENTARY));
+            st.duplicates += __builtin_popcountll(s & _flag_bit(fb, BAM_FDUP));
+            st.mapped += __builtin_popcountll(s & ~unmap);
+
+            // The pairing counts are of the primary reads only.
+            uint64_t p = s & _flag_bit(fb, BAM_FPAIRED) &
+                         ~(_flag_bit(fb, BAM_FSECONDARY) | _flag_bit(fb, BAM_FSUPPLEMENTARY));
+            uint64_t pm = p & ~unmap;
+            st.paired += __builtin_popcountll(p);
+            st.read1 += __builtin_popcountll(p & _flag_bit(fb, BAM_FREAD1));
+            st.read2 += __builtin_popcountll(p & _flag_bit(fb, BAM_FREAD2));
+            st.proper_pair += __builtin_popcountll(pm & _flag_bit(fb, BAM_FPROPER_PAIR));
+            st.both_mapped += __builtin_popcountll(pm & ~_flag_bit(fb, BAM_FMUNMAP));
+            st.singletons += __builtin_popcountll(pm & _flag_bit(fb, BAM_FMUNMAP));
+        }
+    }
+
+    void ColumnBatch::insert_size_hist(std::vector<uint64_t> &hist, hts_pos_t max_isize,
+                                       const Selection *sel) const {
+
+        if (sel && sel->size() != size())
+            throw std::invalid_argument("[column_batch.cpp::ColumnBatch:insert_size_hist] The size of "
+                                        "selection is different from the batch.");
+        if (max_isize <= 0) return;
+        if (hist.size() < (size_t)max_isize + 1) hist.resize(max_isize + 1, 0);
+
+        // Select the records by bitmaps, then only walk the ones which count.
+        size_t n = size();
+        uint64_t fb[_N_FLAG_BITS];
+        for (size_t k = 0, i = 0; i < n; ++k, i += 64) {
+            size_t m = n - i < 64 ? n - i : 64;
+            uint64_t s = sel ? sel->_bits[k] : ~(uint64_t)0;
+            if (!s) continue;
+
+            _flag_bits(&_flag[i], m, fb);
+            s &= _flag_bit(fb, BAM_FPAIRED);
+            if (s) s &= _range_bits(&_isize[i], m, 1, max_isize, false);
+
+            for (; s; s &= s - 1) ++hist[_isize[i + __builtin_ctzll(s)]];
+        }
+    }
+
+}  // namespace ngslib
@@ -0,0 +1,377 @@
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <htslib/sam.h>
+#include "ngslib/coverage.h"
+#include "ngslib/job_runner.h"
+#include "ngslib/utils.h"
+
+namespace ngslib {
+
+    // Depth values kept for the median of a region, longer regions use a
+    // histogram of this size instead.
+    static const size_t MEDIAN_HIST_SIZE = 65536;
+
+    /* out[i] = carry + diff[0] + ... + diff[i], return the last one.
+     * unsigned arithmetic wraps around, so -1 could be stored as 0xFFFFFFFF. */
+    static uint32_t _prefix_sum(const uint32_t *diff, uint32_t *out, size_t n, uint32_t carry) {
+
+        size_t i = 0;
+#ifdef __SSE2__
+        __m128i c = _mm_set1_epi32((int)carry);
+        for (; i + 4 <= n; i += 4) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(diff + i));
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 4));  // [a, a+b, b+c, c+d]
+            x = _mm_add_epi32(x, _mm_slli_si128(x, 8));  // [a, a+b, a+b+c, a+b+c+d]
+            x = _mm_add_epi32(x, c);
+            _mm_storeu_si128((__m128i *)(out + i), x);
+            c = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));  // Broadcast the last one.
+        }
+        carry = (uint32_t)_mm_cvtsi128_si32(c);
+#endif
+        for (; i < n; ++i) {
+            carry += diff[i];
+            out[i] = carry;
+        }
+
+        return carry;
+    }
+
+    // The sliding window of one worker.
+    struct _DepthWindow {
+        std::vector<uint32_t> diff;   // Difference array, one more slot for the end of block.
+        std::vector<uint32_t> depth;
+        bam1_t *b;
+
+        explicit _DepthWindow(size_t window) : diff(window + 1, 0), depth(window), b(bam_init1()) {}
+        ~_DepthWindow() { bam_destroy1(b); }
+
+        size_t capacity() const { return depth.size(); }
+
+        void grow(size_t n) {
+            diff.resize(n + 1, 0);
+            depth.resize(n);
+        }
+    };
+
+    /* Count the depth of one region `r` by reading `itr`.
+     *
+     * [wbeg, wbeg + used) of the genome is in window, positions before wbeg have
+     * been flushed to callback, and `carry` is the depth at wbeg - 1. */
+    static void _sweep(samFile *fp, hts_itr_t *itr, const ReadFilter &filter, const GenomeRegion &r,
+                       _DepthWindow &w, const CoverageCounter::DepthCallback &callback, int worker_id) {
+
+        hts_pos_t wbeg = r.beg;
+        size_t used = 0;
+        uint32_t carry = 0;
+
+        // Flush the final positions [wbeg, to) to callback and slide the window.
+        auto flush = [&](hts_pos_t to) {
+            while (wbeg < to) {
+                size_t n = std::min((size_t)(to - wbeg), w.capacity());
+                carry = _prefix_sum(&w.diff[0], &w.depth[0], n, carry);
+                callback(r.tid, wbeg, &w.depth[0], n, worker_id);
+
+                if (used > n) {
+                    std::memmove(&w.diff[0], &w.diff[n], (used - n) * sizeof(uint32_t));
+                    std::fill(w.diff.begin() + (used - n), w.diff.begin() + used, 0);
+                    used -= n;
+                } else {
+                    std::fill(w.diff.begin(), w.diff.begin() + used, 0);
+                    used = 0;
+                }
+                wbeg += n;
+            }
+        };
+
+        bam1_t *b = w.b;
+        hts_pos_t last_pos = -1;
+        int ret;
+        while ((ret = sam_itr_next(fp, itr, b)) >= 0) {
+
+            if ((b->core.flag & BAM_FUNMAP) || !filter.pass(b)) continue;
+            if (b->core.pos < last_pos) {
+                throw std::invalid_argument("[coverage.cpp::CoverageCounter] The file is not "
+                                            "sorted by coordinate.");
+            }
+            last_pos = b->core.pos;
+
+            // Nothing could be added before this read any more, slide the window
+            // once half of it is final.
+            hts_pos_t start = std::max(b->core.pos, r.beg);
+            if ((size_t)(start - wbeg) >= w.capacity() / 2) flush(start);
+
+            hts_pos_t pos = b->core.pos;
+            const uint32_t *cigar = bam_get_cigar(b);
+            for (uint32_t k = 0; k < b->core.n_cigar; ++k) {
+
+                int op = bam_cigar_op(cigar[k]);
+                hts_pos_t len = bam_cigar_oplen(cigar[k]);
+                if ((bam_cigar_type(op) & 3) == 3) {  // M, = and X consume both query and reference.
+
+                    hts_pos_t x = std::max(pos, r.beg), y = std::min(pos + len, r.end);
+                    if (x < y) {
+                        size_t need = y - wbeg;
+                        if (need > w.capacity()) w.grow(std::max(need, 2 * w.capacity()));
+
+                        ++w.diff[x - wbeg];
+                        --w.diff[need];
+                        used = std::max(used, need + 1);
+                    }
+                }
+
+                if (bam_cigar_type(op) & 2) pos += len;
+            }
+        }
+
+        if (ret < -1) {
+            throw std::invalid_argument("[coverage.cpp::CoverageCounter] Fail to read data in " +
+                                        tostring(r.tid) + ":" + tostring(r.beg + 1) + "-" + tostring(r.end));
+        }
+
+        flush(r.end);
+        std::fill(w.diff.begin(), w.diff.begin() + used, 0);  // The end of blocks at r.end
+    }
+
+    /* Accumulate the depth of the summaries on one reference. Depth comes in
+     * order of positions, a summary is finished once its end is reached. */
+    class _Summarizer {
+
+    private:
+        struct _Acc {
+            double sum;
+            uint64_t n_min_depth;
+            std::vector<uint32_t> values;  // Depth of each position, or a histogram if long.
+            bool hist;
+            bool done;
+
+            _Acc() : sum(0), n_min_depth(0), hist(false), done(false) {}
+        };
+
+        std::vector<size_t> _items;  // Indexes of summaries sorted by start.
+        std::vector<_Acc> _acc;
+        size_t _first;               // All the items before it are done.
+
+        static void _finish(CoverageSummary &s, _Acc &a) {
+
+            hts_pos_t len = s.end - s.beg;
+            s.mean = a.sum / len;
+            s.frac_min_depth = (double)a.n_min_depth / len;
+
+            size_t k = (len - 1) / 2;  // The lower median.
+            if (a.hist) {
+                size_t cum = 0, d = 0;
+                for (; d < a.values.size(); ++d) {
+                    cum += a.values[d];
+                    if (cum > k) break;
+                }
+                s.median = d;
+            } else {
+                std::nth_element(a.values.begin(), a.values.begin() + k, a.values.end());
+                s.median = a.values[k];
+            }
+
+            std::vector<uint32_t>().swap(a.values);  // Release memory.
+            a.done = true;
+        }
+
+    public:
+        _Summarizer() : _first(0) {}
+
+        void add(size_t i) { _items.push_back(i); }
+
+        void init(std::vector<CoverageSummary> &summaries) {
+
+            std::sort(_items.begin(), _items.end(), [&summaries](size_t a, size_t b) {
+                return summaries[a].beg < summaries[b].beg;
+            });
+            _acc.resize(_items.size());
+        }
+
+        void feed(std::vector<CoverageSummary> &summaries, hts_pos_t beg, const uint32_t *depth,
+                  size_t n, uint32_t min_depth) {
+
+            hts_pos_t end = beg + n;
+            for (size_t j = _first; j < _items.size(); ++j) {
+
+                CoverageSummary &s = summaries[_items[j]];
+                if (s.beg >= end) break;
+
+                _Acc &a = _acc[j];
+                if (a.done) continue;
+
+                hts_pos_t x = std::max(s.beg, beg), y = std::min(s.end, end);
+                if (x < y) {
+                    if (a.values.empty()) {
+                        a.hist = (size_t)(s.end - s.beg) > MEDIAN_HIST_SIZE;
+                        if (a.hist) a.values.assign(MEDIAN_HIST_SIZE, 0);
+                    }
+
+                    const uint32_t *d = depth + (x - beg);
+                    for (hts_pos_t i = 0; i < y - x; ++i) {
+                        a.sum += d[i];
+                        if (d[i] >= min_depth) ++a.n_min_depth;
+                        if (a.hist) {
+                            ++a.values[std::min((size_t)d[i], MEDIAN_HIST_SIZE - 1)];
+                        } else {
+                            a.values.push_back(d[i]);
+                        }
+                    }
+                }
+
+                if (s.end <= end) _finish(s, a);
+            }
+
+            while (_first < _items.size() && _acc[_first].done) ++_first;
+        }
+    };
+
+    CoverageCounter::CoverageCounter(const std::string &fn, int nthreads) :
+            _fname(fn), _nthreads(nthreads), _bam(fn, "r"),
+            _filter(0, BAM_FUNMAP | BAM_FSECONDARY | BAM_FQCFAIL | BAM_FDUP),
+            _window(1000000), _min_depth(1) {
+
+        if (nthreads <= 0) {
+            throw std::invalid_argument("[coverage.cpp::CoverageCounter] The number of "
+                                        "threads must be > 0, but got: " + tostring(nthreads));
+        }
+
+        _is_cram = (hts_get_format(_bam.fp())->format == cram);
+        _bam.index_load();  // Load index once, all the BAM workers share it.
+    }
+
+    void CoverageCounter::set_window(size_t window) {
+
+        if (window < 2) {
+            throw std::invalid_argument("[coverage.cpp::CoverageCounter:set_window] The "
+                                        "window is too small: " + tostring(window));
+        }
+        _window = window;
+    }
+
+    void CoverageCounter::_run(const std::vector<GenomeRegion> &regions, const DepthCallback &callback) {
+
+        // One job for all the regions on one reference, the longest first.
+        std::vector<GenomeRegion> merged = merge_regions(regions);
+        std::vector<std::pair<size_t, size_t> > jobs;  // [first, last) in merged
+        std::vector<hts_pos_t> job_len;
+        for (size_t i = 0; i < merged.size(); ++i) {
+            if (merged[i].tid < 0) continue;
+            if (jobs.empty() || merged[jobs.back().first].tid != merged[i].tid) {
+                jobs.push_back(std::make_pair(i, i));
+                job_len.push_back(0);
+            }
+            jobs.back().second = i + 1;
+            job_len.back() += merged[i].length();
+        }
+
+        std::vector<size_t> order(jobs.size());
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::sort(order.begin(), order.end(), [&job_len](size_t a, size_t b) { return job_len[a] > job_len[b]; });
+
+        JobRunner runner(jobs.size());
+        runner.run(std::min((size_t)_nthreads, jobs.size()), [&](int i) {
+            // Private file handle for each worker, only decode what's needed.
+            Bam bam(_fname, "r");
+            bam.set_fields(Fields::FLAG | Fields::RNAME | Fields::POS | Fields::MAPQ | Fields::CIGAR);
+            hts_idx_t *idx = _is_cram ? bam.idx() : _bam.idx();
+            _DepthWindow window(_window);
+
+            size_t j;
+            while (runner.next_job(j)) {
+                for (size_t k = jobs[order[j]].first; k < jobs[order[j]].second; ++k) {
+
+                    const GenomeRegion &r = merged[k];
+                    hts_itr_t *itr = sam_itr_queryi(idx, r.tid, r.beg, r.end);
+                    if (!itr) {
+                        throw std::invalid_argument("[coverage.cpp::CoverageCounter] Fail to "
+                                                    "fetch " + r.to_string(_bam.header()));
+                    }
+
+                    try {
+                        _sweep(bam.fp(), itr, _filter, r, window, callback, i);
+                    } catch (...) {
+                        sam_itr_destroy(itr);
+                        throw;
+                    }
+                    sam_itr_destroy(itr);
+                }
+            }
+        });
+    }
+
+    void CoverageCounter::run(const DepthCallback &callback) {
+        _run(split_genome(header(), HTS_POS_MAX), callback);
+    }
+
+    void CoverageCounter::run(const std::vector<GenomeRegion> &regions, const DepthCallback &callback) {
+        _run(regions, callback);
+    }
+
+    void CoverageCounter::_summarize(std::vector<CoverageSummary> &summaries,
+                                     const std::vector<GenomeRegion> &regions) {
+
+        // Each reference is counted by one worker, so is its summarizer.
+        std::vector<_Summarizer> summarizers(header().h()->n_targets);
+        for (size_t i = 0; i < summaries.size(); ++i) {
+            CoverageSummary &s = summaries[i];
+            s.mean = s.frac_min_depth = 0;
+            s.median = 0;
+            if (s.tid >= 0 && s.tid < (int)summarizers.size() && s.end > s.beg) summarizers[s.tid].add(i);
+        }
+        for (size_t i = 0; i < summarizers.size(); ++i) {
+            summarizers[i].init(summaries);
+        }
+
+        uint32_t min_depth = _min_depth;
+        _run(regions, [&summaries, &summarizers, min_depth](int tid, hts_pos_t beg, const uint32_t *depth,
+                                                             size_t n, int /*worker_id*/) {
+            summarizers[tid].feed(summaries, beg, depth, n, min_depth);
+        });
+    }
+
+    std::vector<CoverageSummary> CoverageCounter::bins(hts_pos_t bin_size) {
+
+        if (bin_size <= 0) {
+            throw std::invalid_argument("[coverage.cpp::CoverageCounter:bins] bin_size must be > 0.");
+        }
+
+        std::vector<CoverageSummary> summaries;
+        std::vector<GenomeRegion> genome = split_genome(header(), HTS_POS_MAX);
+        for (size_t i = 0; i < genome.size(); ++i) {
+            for (hts_pos_t beg = genome[i].beg; beg < genome[i].end; beg += bin_size) {
+                CoverageSummary s;
+                s.tid = genome[i].tid;
+                s.beg = beg;
+                s.end = std::min(beg + bin_size, genome[i].end);
+                summaries.push_back(s);
+            }
+        }
+
+        _summarize(summaries, genome);
+        return summaries;
+    }
+
+    std::vector<CoverageSummary> CoverageCounter::targets(const std::vector<GenomeRegion> &regions) {
+
+        std::vector<CoverageSummary> summaries(regions.size());
+        for (size_t i = 0; i < regions.size(); ++i) {
+            summaries[i].tid = regions[i].tid;
+            summaries[i].beg = regions[i].beg;
+            summaries[i].end = regions[i].end;
+        }
+
+        _summarize(summaries, regions);
+        return summaries;
+    }
+
+    std::vector<CoverageSummary> CoverageCounter::targets(const std::string &bed_fn) {
+        return targets(load_bed(header(), bed_fn));
+    }
+
+}  // namespace ngslib
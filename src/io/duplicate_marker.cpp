@@ -0,0 +1,604 @@
+#include <stdexcept>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <tuple>
+
+#include <htslib/sam.h>
+#include <htslib/bgzf.h>
+#include "ngslib/duplicate_marker.h"
+#include "ngslib/bam_writer.h"
+#include "ngslib/job_runner.h"
+#include "ngslib/utils.h"
+
+namespace ngslib {
+
+    // The groups at 5' position p are closed once the stream is past p + window,
+    // the window grows to the longest clipping of forward reads seen.
+    static const hts_pos_t DUP_MIN_WINDOW = 1000;
+
+    // The empty block at the end of every BGZF file.
+    static const char BGZF_EOF[28] = {'\037', '\213', '\010', '\4', '\0', '\0', '\0', '\0', '\0', '\377',
+                                      '\6', '\0', '\102', '\103', '\2', '\0', '\033', '\0', '\3', '\0',
+                                      '\0', '\0', '\0', '\0', '\0', '\0', '\0', '\0'};
+
+    static uint64_t _fnv1a(const char *s, size_t n) {
+
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < n; ++i) {
+            h = (h ^ (unsigned char)s[i]) * 1099511628211ULL;
+        }
+        return h;
+    }
+
+    // The unclipped 5' end of the read.
+    static hts_pos_t _unclipped_5p(const bam1_t *b) {
+
+        const uint32_t *cigar = bam_get_cigar(b);
+        uint32_t n = b->core.n_cigar;
+        hts_pos_t clip = 0;
+        if (bam_is_rev(b)) {
+            for (uint32_t i = n; i > 0; --i) {
+                int op = bam_cigar_op(cigar[i - 1]);
+                if (op != BAM_CSOFT_CLIP && op != BAM_CHARD_CLIP) break;
+                clip += bam_cigar_oplen(cigar[i - 1]);
+            }
+            return bam_endpos(b) - 1 + clip;
+        }
+
+        for (uint32_t i = 0; i < n; ++i) {
+            int op = bam_cigar_op(cigar[i]);
+            if (op != BAM_CSOFT_CLIP && op != BAM_CHARD_CLIP) break;
+            clip += bam_cigar_oplen(cigar[i]);
+        }
+        return b->core.pos - clip;
+    }
+
+    // The unclipped 5' end of the mate by the MC tag, false if there is no MC.
+    static bool _mate_unclipped_5p(const bam1_t *b, hts_pos_t &end) {
+
+        uint8_t *mc = bam_aux_get(b, "MC");
+        const char *s = mc ? bam_aux2Z(mc) : NULL;
+        if (!s || *s == '*') return false;
+
+        hts_pos_t lclip = 0, rclip = 0, rlen = 0;
+        bool aligned = false;
+        while (*s) {
+            char *p;
+            long len = std::strtol(s, &p, 10);
+            if (p == s || !*p) return false;
+
+            if (*p == 'S' || *p == 'H') {
+                if (aligned) {
+                    rclip += len;
+                } else {
+                    lclip += len;
+                }
+            } else {
+                aligned = true;
+                rclip = 0;  // Only the clipping at the end counts.
+                if (*p == 'M' || *p == 'D' || *p == 'N' || *p == '=' || *p == 'X') rlen += len;
+            }
+            s = p + 1;
+        }
+
+        end = (b->core.flag & BAM_FMREVERSE) ? b->core.mpos + rlen - 1 + rclip : b->core.mpos - lclip;
+        return true;
+    }
+
+    // Sum of base qualities >= 15, the same as the ms tag of samtools fixmate.
+    static int _base_score(const bam1_t *b) {
+
+        const uint8_t *q = bam_get_qual(b);
+        if (b->core.l_qseq == 0 || q[0] == 0xff) return 0;
+
+        int score = 0;
+        for (int32_t i = 0; i < b->core.l_qseq; ++i) {
+            if (q[i] >= 15) score += q[i];
+        }
+        return score;
+    }
+
+    // Where the reads of one template end. Paired reads are keyed by both
+    // ends, seen from their own end, so the two reads are in two groups with
+    // the same templates.
+    struct _DupKey {
+        hts_pos_t pos;    // Unclipped 5' end of the read (or the leftmost if MC is missing).
+        int32_t tid;
+        int32_t rev;
+        int32_t paired;
+        int32_t mtid;
+        hts_pos_t mpos;
+        int32_t mrev;
+        uint64_t umi;
+
+        bool operator<(const _DupKey &k) const {
+            return std::tie(pos, tid, rev, paired, mtid, mpos, mrev, umi) <
+                   std::tie(k.pos, k.tid, k.rev, k.paired, k.mtid, k.mpos, k.mrev, k.umi);
+        }
+    };
+
+    // A read in a group, just enough to make the decision.
+    struct _DupRead {
+        uint64_t slot;    // Sequence number in the output buffer.
+        uint64_t name;    // Hash of qname.
+        int32_t score;
+        uint64_t tile;    // Hash of qname up to the tile field, 0 if unknown.
+        int32_t x, y;
+    };
+
+    struct _DupGroup {
+        std::vector<_DupRead> reads;
+        bool has_pair;    // A pair ends here, all the single reads are duplicates.
+
+        _DupGroup() : has_pair(false) {}
+    };
+
+    // Mark the duplicates of one job (some references) and write the records
+    // to one part of output.
+    class _DupWorker {
+
+    private:
+        struct _Slot {
+            bam1_t *b;
+            bool pending;  // Waiting for the decision of its group.
+        };
+
+        BGZF *_out;
+        std::string _umi_tag;
+        int _optical_distance;
+        bool _remove;
+
+        std::map<_DupKey, _DupGroup> _groups;
+        std::deque<_Slot> _buffer;
+        uint64_t _base;             // Sequence number of _buffer.front()
+        std::vector<bam1_t *> _spare;
+        hts_pos_t _window;
+
+        int32_t _tid;
+        hts_pos_t _last_pos;
+
+        void _decide(_DupGroup &g, bool fragment) {
+
+            if (g.reads.empty()) return;
+
+            // The best template: highest score, ties broken by the hash of name,
+            // which is the same at both ends of a pair.
+            const _DupRead *best = &g.reads[0];
+            for (size_t i = 1; i < g.reads.size(); ++i) {
+                const _DupRead &r = g.reads[i];
+                if (r.score > best->score || (r.score == best->score && r.name < best->name)) best = &r;
+            }
+            bool keep_none = fragment && g.has_pair;
+
+            std::vector<bool> near(g.reads.size(), false);
+            if (_optical_distance > 0 && g.reads.size() > 1) _find_optical(g.reads, near);
+
+            for (size_t i = 0; i < g.reads.size(); ++i) {
+                const _DupRead &r = g.reads[i];
+                _Slot &s = _buffer[r.slot - _base];
+                s.pending = false;
+                if (!keep_none && r.name == best->name) continue;
+
+                s.b->core.flag |= BAM_FDUP;
+                ++stats.n_duplicates;
+                if (near[i]) {
+                    ++stats.n_optical;
+                    if (bam_aux_update_str(s.b, "dt", 3, "SQ") < 0) {
+                        throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker] Fail to "
+                                                    "add dt tag.");
+                    }
+                }
+            }
+        }
+
+        // near[i] is true if the i-th read is close to another template on the
+        // same tile.
+        void _find_optical(const std::vector<_DupRead> &reads, std::vector<bool> &near) const {
+
+            std::vector<size_t> order;
+            for (size_t i = 0; i < reads.size(); ++i) {
+                if (reads[i].tile) order.push_back(i);
+            }
+            std::sort(order.begin(), order.end(), [&reads](size_t a, size_t b) {
+                return std::tie(reads[a].tile, reads[a].x) < std::tie(reads[b].tile, reads[b].x);
+            });
+
+            for (size_t i = 0; i < order.size(); ++i) {
+                const _DupRead &a = reads[order[i]];
+                for (size_t j = i + 1; j < order.size(); ++j) {
+                    const _DupRead &b = reads[order[j]];
+                    if (b.tile != a.tile || b.x - a.x > _optical_distance) break;
+                    if (a.name != b.name && std::abs(b.y - a.y) <= _optical_distance) {
+                        near[order[i]] = near[order[j]] = true;
+                    }
+                }
+            }
+        }
+
+        // Close the groups which no read could join any more.
+        void _close(hts_pos_t pos, bool all) {
+
+            while (!_groups.empty()) {
+                std::map<_DupKey, _DupGroup>::iterator it = _groups.begin();
+                if (!all && it->first.pos + _window >= pos) break;
+
+                _decide(it->second, !it->first.paired);
+                _groups.erase(it);
+            }
+            _flush();
+        }
+
+        // Write the records at the front which have been decided.
+        void _flush() {
+
+            while (!_buffer.empty() && !_buffer.front().pending) {
+                bam1_t *b = _buffer.front().b;
+                if (!(_remove && (b->core.flag & BAM_FDUP)) && bam_write1(_out, b) < 0) {
+                    throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker] Fail to "
+                                                "write the output.");
+                }
+                _spare.push_back(b);
+                _buffer.pop_front();
+                ++_base;
+            }
+        }
+
+        void _tile(const bam1_t *b, _DupRead &r) const {
+
+            // Illumina: <instrument>:<run>:<flowcell>:<lane>:<tile>:<x>:<y>
+            r.tile = 0;
+            r.x = r.y = 0;
+            const char *qname = bam_get_qname(b);
+            const char *c3 = std::strrchr(qname, ':');
+            if (!c3) return;
+
+            const char *c2 = c3 - 1;
+            while (c2 >= qname && *c2 != ':') --c2;
+            if (c2 < qname) return;
+
+            r.tile = _fnv1a(qname, c2 - qname) | 1;  // Never 0
+            r.x = std::atoi(c2 + 1);
+            r.y = std::atoi(c3 + 1);
+        }
+
+    public:
+        DuplicateStats stats;
+
+        _DupWorker(BGZF *out, const std::string &umi_tag, int optical_distance, bool remove) :
+                _out(out), _umi_tag(umi_tag), _optical_distance(optical_distance), _remove(remove),
+                _base(0), _window(DUP_MIN_WINDOW), _tid(-1), _last_pos(-1) {}
+
+        ~_DupWorker() {
+            for (size_t i = 0; i < _buffer.size(); ++i) bam_destroy1(_buffer[i].b);
+            for (size_t i = 0; i < _spare.size(); ++i) bam_destroy1(_spare[i]);
+        }
+
+        bam1_t *new_record() {
+            if (_spare.empty()) return bam_init1();
+
+            bam1_t *b = _spare.back();
+            _spare.pop_back();
+            return b;
+        }
+
+        // Take a record of the stream.
+        void add(bam1_t *b) {
+
+            b->core.flag &= ~BAM_FDUP;
+            if (b->core.tid != _tid) {
+                _close(0, true);
+                _tid = b->core.tid;
+                _last_pos = -1;
+            }
+            if (b->core.pos < _last_pos) {
+                throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker] The input is "
+                                            "not sorted by coordinate: " + std::string(bam_get_qname(b)));
+            }
+            _last_pos = b->core.pos;
+
+            _Slot slot = {b, false};
+            _buffer.push_back(slot);
+            uint16_t flag = b->core.flag;
+            if (flag & (BAM_FUNMAP | BAM_FSECONDARY | BAM_FSUPPLEMENTARY)) {
+                _close(b->core.pos, false);
+                return;
+            }
+
+            ++stats.n_reads;
+            _buffer.back().pending = true;
+
+            _DupRead r;
+            r.slot = _base + _buffer.size() - 1;
+            r.name = _fnv1a(bam_get_qname(b), b->core.l_qname - b->core.l_extranul - 1);
+            r.score = _base_score(b);
+            if (_optical_distance > 0) _tile(b, r);
+
+            _DupKey k;
+            k.pos = _unclipped_5p(b);
+            k.tid = b->core.tid;
+            k.rev = bam_is_rev(b) ? 1 : 0;
+            k.paired = 0;
+            k.mtid = -1;
+            k.mpos = -1;
+            k.mrev = 0;
+            k.umi = 0;
+            if (!_umi_tag.empty()) {
+                uint8_t *s = bam_aux_get(b, _umi_tag.c_str());
+                const char *umi = s ? bam_aux2Z(s) : NULL;
+                if (umi) k.umi = _fnv1a(umi, std::strlen(umi));
+            }
+            if (!k.rev) _window = std::max(_window, b->core.pos - k.pos);
+
+            // Close the groups before adding this read, it may reuse the buffer.
+            _close(b->core.pos, false);
+
+            if ((flag & BAM_FPAIRED) && !(flag & BAM_FMUNMAP)) {
+                ++stats.n_paired;
+                _groups[k].has_pair = true;  // The group of single reads at this end.
+
+                _DupKey pk = k;
+                pk.paired = 1;
+                pk.mtid = b->core.mtid;
+                pk.mrev = (flag & BAM_FMREVERSE) ? 1 : 0;
+                if (!_mate_unclipped_5p(b, pk.mpos)) {
+                    // The clipping of mate is unknown, both reads use the leftmost
+                    // positions.
+                    pk.pos = b->core.pos;
+                    pk.mpos = b->core.mpos;
+                }
+
+                uint8_t *ms = bam_aux_get(b, "ms");
+                // Both reads must see the same score, or nothing but the name.
+                r.score = ms ? r.score + (int32_t)bam_aux2i(ms) : 0;
+                _groups[pk].reads.push_back(r);
+
+            } else {
+                _groups[k].reads.push_back(r);
+            }
+        }
+
+        // The end of the job.
+        void finish() { _close(0, true); }
+    };
+
+    std::ostream &operator<<(std::ostream &os, const DuplicateStats &s) {
+
+        os << "reads\t" << s.n_reads << "\n"
+           << "paired\t" << s.n_paired << "\n"
+           << "duplicates\t" << s.n_duplicates << "\n"
+           << "optical\t" << s.n_optical << "\n";
+
+        return os;
+    }
+
+    DuplicateMarker::DuplicateMarker(const std::string &fn, int nthreads) :
+            _fname(fn), _nthreads(nthreads), _bam(fn, "r"), _optical_distance(0), _remove(false),
+            _compress_level(-1), _index(false), _min_shift(0) {
+
+        if (nthreads <= 0) {
+            throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker] The number of "
+                                        "threads must be > 0, but got: " + tostring(nthreads));
+        }
+
+        _is_cram = (hts_get_format(_bam.fp())->format == cram);
+        _bam.index_load();  // Load index once, all the BAM workers share it.
+    }
+
+    void DuplicateMarker::set_umi_tag(const std::string &tag) {
+
+        if (!tag.empty() && tag.size() != 2) {
+            throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker:set_umi_tag] "
+                                        "Invalid tag: " + tag);
+        }
+        _umi_tag = tag;
+    }
+
+    // Append the BGZF blocks of `fn` to `out` without the EOF block.
+    static void _append_part(std::FILE *out, const std::string &fn) {
+
+        std::FILE *in = std::fopen(fn.c_str(), "rb");
+        if (!in) {
+            throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker] Fail to open " + fn);
+        }
+
+        std::vector<char> buf(1 << 20);
+        std::fseek(in, 0, SEEK_END);
+        long size = std::ftell(in);
+        if (size >= (long)sizeof(BGZF_EOF)) {
+            std::fseek(in, size - sizeof(BGZF_EOF), SEEK_SET);
+            if (std::fread(&buf[0], 1, sizeof(BGZF_EOF), in) == sizeof(BGZF_EOF) &&
+                std::memcmp(&buf[0], BGZF_EOF, sizeof(BGZF_EOF)) == 0) {
+                size -= sizeof(BGZF_EOF);
+            }
+        }
+
+        std::fseek(in, 0, SEEK_SET);
+        while (size > 0) {
+            size_t n = std::fread(&buf[0], 1, std::min((long)buf.size(), size), in);
+            if (n == 0 || std::fwrite(&buf[0], 1, n, out) != n) {
+                std::fclose(in);
+                throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker] Fail to copy " + fn);
+            }
+            size -= n;
+        }
+        std::fclose(in);
+    }
+
+    // Join the BGZF blocks of parts into `out_fn` by bytes, parts[0] is filled
+    // with the header, then add the EOF block.
+    static void _join_parts(const std::vector<std::string> &parts, const std::string &out_fn,
+                            const BamHeader &hdr, const std::string &mode) {
+
+        BGZF *fp = bgzf_open(parts[0].c_str(), mode.c_str());
+        if (!fp || bam_hdr_write(fp, hdr.h()) < 0 || bgzf_close(fp) < 0) {
+            throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker:run] Fail to "
+                                        "write the header to " + parts[0]);
+        }
+
+        std::FILE *out = std::fopen(out_fn.c_str(), "wb");
+        if (!out) {
+            throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker:run] Fail to "
+                                        "open " + out_fn);
+        }
+        try {
+            for (size_t i = 0; i < parts.size(); ++i) {
+                _append_part(out, parts[i]);
+            }
+        } catch (...) {
+            std::fclose(out);
+            throw;
+        }
+
+        if (std::fwrite(BGZF_EOF, 1, sizeof(BGZF_EOF), out) != sizeof(BGZF_EOF) || std::fclose(out) != 0) {
+            throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker:run] Fail to "
+                                        "write " + out_fn);
+        }
+    }
+
+    // Re-encode the records of parts[1:] in order by `out`, for the output
+    // which could not be joined by bytes (CRAM).
+    static void _write_parts(const std::vector<std::string> &parts, BamWriter &out) {
+
+        bam1_t *b = bam_init1();
+        int ret = -1;
+        for (size_t i = 1; i < parts.size() && ret == -1; ++i) {
+            BGZF *in = bgzf_open(parts[i].c_str(), "r");
+            if (!in) {
+                bam_destroy1(b);
+                throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker] Fail to open " + parts[i]);
+            }
+
+            while ((ret = bam_read1(in, b)) >= 0) {
+                if (out.write(b) < 0) {
+                    ret = -2;
+                    break;
+                }
+            }
+            bgzf_close(in);
+        }
+        bam_destroy1(b);
+
+        if (ret < -1 || out.close() < 0) {
+            throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker] Fail to re-encode "
+                                        "the records of temporary parts.");
+        }
+    }
+
+    DuplicateStats DuplicateMarker::run(const std::string &out_fn, const std::string &out_mode) {
+
+        // Jobs of adjacent references with similar total length, the unmapped
+        // reads without coordinate are the last job.
+        const sam_hdr_t *h = header().h();
+        hts_pos_t total = 0;
+        for (int i = 0; i < h->n_targets; ++i) total += sam_hdr_tid2len(h, i);
+        hts_pos_t job_size = total / (4 * _nthreads) + 1;
+
+        std::vector<std::pair<int, int> > jobs;  // [first tid, last tid), -1 for unmapped
+        hts_pos_t len = 0;
+        for (int i = 0; i < h->n_targets; ++i) {
+            if (jobs.empty() || len >= job_size) {
+                jobs.push_back(std::make_pair(i, i));
+                len = 0;
+            }
+            jobs.back().second = i + 1;
+            len += sam_hdr_tid2len(h, i);
+        }
+        jobs.push_back(std::make_pair(-1, -1));
+
+        // parts[0] is the header.
+        std::vector<std::string> parts(jobs.size() + 1);
+        for (size_t i = 0; i < parts.size(); ++i) {
+            parts[i] = out_fn + ".tmp." + tostring(i) + ".bgz";
+        }
+
+        // The parts of CRAM are read back, compress them fast.
+        bool to_cram = out_mode.find('c') != std::string::npos;
+        std::string mode = to_cram ? "w1" : (_compress_level >= 0 ? "w" + tostring(std::min(_compress_level, 9)) : "w");
+
+        JobRunner runner(jobs.size());
+        size_t n_worker = std::min((size_t)_nthreads, jobs.size());
+        std::vector<DuplicateStats> stats(n_worker);
+        try {
+            runner.run(n_worker, [&](int i) {
+                Bam bam(_fname, "r");  // Private file handle for each worker.
+                hts_idx_t *idx = _is_cram ? bam.idx() : _bam.idx();
+
+                size_t j;
+                while (runner.next_job(j)) {
+                    BGZF *out = bgzf_open(parts[j + 1].c_str(), mode.c_str());
+                    if (!out) {
+                        throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker] "
+                                                    "Fail to open " + parts[j + 1]);
+                    }
+
+                    int ret = 0;
+                    try {
+                        _DupWorker w(out, _umi_tag, _optical_distance, _remove);
+                        int beg = jobs[j].first, end = jobs[j].second;
+                        if (beg < 0) {  // The unmapped reads
+                            beg = HTS_IDX_NOCOOR;
+                            end = HTS_IDX_NOCOOR + 1;
+                        }
+
+                        for (int tid = beg; tid < end && ret >= -1; ++tid) {
+                            hts_itr_t *itr = sam_itr_queryi(idx, tid, 0, HTS_POS_MAX);
+                            if (!itr) {
+                                throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker] "
+                                                            "Fail to fetch reference " + tostring(tid));
+                            }
+
+                            bam1_t *b = w.new_record();
+                            while ((ret = sam_itr_next(bam.fp(), itr, b)) >= 0) {
+                                w.add(b);
+                                b = w.new_record();
+                            }
+                            bam_destroy1(b);
+                            sam_itr_destroy(itr);
+                        }
+                        w.finish();
+                        stats[i] += w.stats;
+
+                    } catch (...) {
+                        bgzf_close(out);
+                        throw;
+                    }
+
+                    if (bgzf_close(out) < 0 || ret < -1) {
+                        throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker] Fail to "
+                                                    "process reference " + tostring(jobs[j].first));
+                    }
+                }
+            });
+
+            if (to_cram) {
+                BamWriter out(out_fn, header(), out_mode, _nthreads);
+                if (!_reference.empty()) out.set_reference(_reference);
+                if (_index) out.set_index(_min_shift);
+                _write_parts(parts, out);
+            } else {
+                _join_parts(parts, out_fn, header(), mode);
+            }
+
+        } catch (...) {
+            for (size_t i = 0; i < parts.size(); ++i) std::remove(parts[i].c_str());
+            throw;
+        }
+
+        DuplicateStats total_stats;
+        for (size_t i = 0; i < n_worker; ++i) total_stats += stats[i];
+        for (size_t i = 0; i < parts.size(); ++i) std::remove(parts[i].c_str());
+
+        // BAM is joined by bytes, so it's indexed by another (threaded) pass.
+        if (!to_cram && _index && Bam(out_fn, "r").index_build(_min_shift, _nthreads) != 0) {
+            throw std::invalid_argument("[duplicate_marker.cpp::DuplicateMarker:run] Fail to "
+                                        "index " + out_fn);
+        }
+
+        return total_stats;
+    }
+
+}  // namespace ngslib
@@ -21,8 +21,25 @@ namespace ngslib {
         }
     }
 
-    Fasta::Fasta(const Fasta &ft) {  // copy constructor
-        this->_load_data(ft.fname.c_str());   // re-load FASTA file.
+    Fasta::Fasta(const Fasta &ft) : fai(NULL) {  // copy constructor
+        if (ft.fai) this->_load_data(ft.fname.c_str());   // re-load FASTA file.
+    }
+
+    Fasta &Fasta::operator=(Fasta &&fa) noexcept {
+
+        if (this != &fa) {
+            if (fai) fai_destroy(fai);
+
+            fname.swap(fa.fname);
+            _seq.swap(fa._seq);
+            fai = fa.fai;
+
+            fa.fname.clear();
+            fa._seq.clear();
+            fa.fai = NULL;
+        }
+
+        return *this;
     }
 
     Fasta &Fasta::operator=(const char *file_name) {
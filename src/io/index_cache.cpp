@@ -0,0 +1,143 @@
+#include <stdexcept>
+#include <algorithm>
+#include <sys/stat.h>
+
+#include "ngslib/index_cache.h"
+#include "ngslib/utils.h"
+
+namespace ngslib {
+
+    // Return false if the file is not found.
+    static bool _file_stat(const std::string &fn, time_t &mtime, size_t &size) {
+
+        struct stat st;
+        if (stat(fn.c_str(), &st) != 0) return false;
+
+        mtime = st.st_mtime;
+        size = st.st_size;
+        return true;
+    }
+
+    // Search the index file of `fn`: fn.csi, fn.bai, or replace extension by .bai
+    static std::string _locate_index(const std::string &fn) {
+
+        std::string candidates[3] = {fn + ".csi", fn + ".bai", ""};
+        size_t dot = fn.rfind('.');
+        if (dot != std::string::npos && fn.find('/', dot) == std::string::npos)
+            candidates[2] = fn.substr(0, dot) + ".bai";
+
+        for (size_t i = 0; i < 3; ++i) {
+            if (!candidates[i].empty() && is_readable(candidates[i]))
+                return candidates[i];
+        }
+
+        return "";
+    }
+
+    IndexCache &IndexCache::instance() {
+        static IndexCache cache;  // Thread-safe initialization in C++11.
+        return cache;
+    }
+
+    SharedIndex IndexCache::load(const std::string &fn) {
+
+        std::string fnidx = _locate_index(fn);
+        time_t mtime, idx_mtime;
+        size_t size, idx_size;
+        if (fnidx.empty() || !_file_stat(fn, mtime, size) || !_file_stat(fnidx, idx_mtime, idx_size)) {
+            throw std::invalid_argument("[index_cache.cpp::IndexCache:load] Failed to load index "
+                                        "of " + fn + ", the file or the index file is not "
+                                        "available. Rebuild by samtools index please.");
+        }
+        mtime = std::max(mtime, idx_mtime);
+
+        {
+            std::lock_guard<std::mutex> guard(_lock);
+            std::map<std::string, Entry>::iterator it = _entries.find(fn);
+            if (it != _entries.end() && it->second.fnidx == fnidx && it->second.mtime == mtime) {
+                ++_hit;
+                it->second.last_use = ++_tick;
+                return it->second.idx;
+            }
+            ++_miss;
+        }
+
+        // Load without the lock, it may take seconds for a large index.
+        hts_idx_t *idx = hts_idx_load2(fn.c_str(), fnidx.c_str());
+        if (!idx) {
+            throw std::invalid_argument("[index_cache.cpp::IndexCache:load] Failed to load "
+                                        "index file " + fnidx);
+        }
+        SharedIndex loaded(idx, hts_idx_destroy);
+
+        std::lock_guard<std::mutex> guard(_lock);
+        std::map<std::string, Entry>::iterator it = _entries.find(fn);
+        if (it != _entries.end()) {
+            if (it->second.fnidx == fnidx && it->second.mtime == mtime) {
+                // Cached by another thread meanwhile, use that one and free ours.
+                it->second.last_use = ++_tick;
+                return it->second.idx;
+            }
+
+            // Stale, the users of the old one still keep it alive.
+            _bytes -= it->second.bytes;
+            _entries.erase(it);
+        }
+
+        Entry &e = _entries[fn];
+        e.idx = loaded;
+        e.fnidx = fnidx;
+        e.mtime = mtime;
+        e.bytes = (hts_idx_fmt(idx) == HTS_FMT_CSI) ? idx_size * 3 : idx_size;
+        e.last_use = ++_tick;
+
+        _bytes += e.bytes;
+        SharedIndex ret = e.idx;
+        _evict();
+
+        return ret;
+    }
+
+    void IndexCache::_evict() {
+
+        while (_bytes > _budget) {
+
+            std::map<std::string, Entry>::iterator lru = _entries.end();
+            for (std::map<std::string, Entry>::iterator it = _entries.begin(); it != _entries.end(); ++it) {
+                if (it->second.idx.use_count() > 1) continue;  // In use.
+                if (lru == _entries.end() || it->second.last_use < lru->second.last_use)
+                    lru = it;
+            }
+
+            if (lru == _entries.end()) break;  // All in use.
+
+            _bytes -= lru->second.bytes;
+            _entries.erase(lru);
+        }
+    }
+
+    void IndexCache::set_budget(size_t bytes) {
+
+        std::lock_guard<std::mutex> guard(_lock);
+        _budget = bytes;
+        _evict();
+    }
+
+    void IndexCache::drop(const std::string &fn) {
+
+        std::lock_guard<std::mutex> guard(_lock);
+        std::map<std::string, Entry>::iterator it = _entries.find(fn);
+        if (it != _entries.end()) {
+            _bytes -= it->second.bytes;
+            _entries.erase(it);
+        }
+    }
+
+    void IndexCache::clear() {
+
+        std::lock_guard<std::mutex> guard(_lock);
+        _entries.clear();
+        _bytes = 0;
+    }
+
+}  // namespace ngslib
@@ -0,0 +1,152 @@
+#include <stdexcept>
+#include <algorithm>
+
+#include <htslib/sam.h>
+#include "ngslib/index_stats.h"
+#include "ngslib/utils.h"
+
+namespace ngslib {
+
+    // Sum the compressed size of all the chunks of `tid` in index.
+    static int64_t _estimate_bytes(const hts_idx_t *idx, int tid) {
+
+        hts_itr_t *itr = sam_itr_queryi(idx, tid, 0, HTS_POS_MAX);
+        if (!itr) return -1;
+
+        // The upper 48 bits of a virtual offset is the file offset of BGZF block.
+        int64_t bytes = 0;
+        for (int i = 0; i < itr->n_off; ++i) {
+            bytes += (int64_t)(itr->off[i].v >> 16) - (int64_t)(itr->off[i].u >> 16);
+        }
+
+        sam_itr_destroy(itr);
+        return bytes;
+    }
+
+    // The compressed size of chunks overlapping [beg, end) of `tid`. A chunk in
+    // one BGZF block counts 1 byte, so a window with reads is never 0.
+    static int64_t _window_bytes(const hts_idx_t *idx, int tid, hts_pos_t beg, hts_pos_t end) {
+
+        hts_itr_t *itr = sam_itr_queryi(idx, tid, beg, end);
+        if (!itr) return 0;
+
+        int64_t bytes = 0;
+        for (int i = 0; i < itr->n_off; ++i) {
+            if (itr->off[i].v <= itr->off[i].u) continue;
+            bytes += std::max((int64_t)(itr->off[i].v >> 16) - (int64_t)(itr->off[i].u >> 16), (int64_t)1);
+        }
+
+        sam_itr_destroy(itr);
+        return bytes;
+    }
+
+    IndexStats index_stats(hts_idx_t *idx, const BamHeader &hdr) {
+
+        if (!idx || !hdr) {
+            throw std::invalid_argument("[index_stats.cpp::index_stats] The index or header is NULL.");
+        }
+
+        bool is_crai = (hts_idx_fmt(idx) == HTS_FMT_CRAI);
+
+        IndexStats stats;
+        stats.n_no_coor = is_crai ? -1 : (int64_t)hts_idx_get_n_no_coor(idx);
+
+        int n = hdr.h()->n_targets;
+        stats.contigs.resize(n);
+        for (int tid = 0; tid < n; ++tid) {
+
+            ContigStats &c = stats.contigs[tid];
+            c.tid = tid;
+            c.name = hdr.seq_name(tid);
+            c.length = hdr.seq_length(tid);
+            c.mapped = c.unmapped = c.bytes = -1;
+            if (is_crai) continue;
+
+            c.bytes = _estimate_bytes(idx, tid);
+            uint64_t mapped, unmapped;
+            if (hts_idx_get_stat(idx, tid, &mapped, &unmapped) == 0) {
+                c.mapped = mapped;
+                c.unmapped = unmapped;
+            } else if (c.bytes == 0) {
+                c.mapped = c.unmapped = 0;  // No chunk, no read on this sequence.
+            }  // Else the index has reads but no counts (no meta pseudo-bin), unknown.
+        }
+
+        return stats;
+    }
+
+    std::vector<GenomeRegion> split_genome_by_bytes(hts_idx_t *idx, const BamHeader &hdr, size_t n_shards,
+                                                    hts_pos_t resolution) {
+
+        if (!idx || !hdr) {
+            throw std::invalid_argument("[index_stats.cpp::split_genome_by_bytes] The index or "
+                                        "header is NULL.");
+        }
+        if (n_shards == 0 || resolution <= 0) {
+            throw std::invalid_argument("[index_stats.cpp::split_genome_by_bytes] n_shards and "
+                                        "resolution must be > 0, but got: " + tostring(n_shards) +
+                                        " and " + tostring(resolution));
+        }
+
+        int n = hdr.h()->n_targets;
+        if (hts_idx_fmt(idx) == HTS_FMT_CRAI) {
+            hts_pos_t total = 0;
+            for (int tid = 0; tid < n; ++tid) total += hdr.seq_length(tid);
+            return split_genome(hdr, std::max(total / (hts_pos_t)n_shards, (hts_pos_t)1));
+        }
+
+        // Estimate the bytes of every window of every sequence.
+        std::vector<std::vector<int64_t> > bytes(n);
+        int64_t total = 0;
+        for (int tid = 0; tid < n; ++tid) {
+
+            // Nothing on this sequence, no need to look into it. The stat may
+            // be missing (no meta pseudo-bin) though there are reads, then the
+            // windows tell, and a sequence of all-empty windows gets no shard.
+            uint64_t mapped, unmapped;
+            if (hts_idx_get_stat(idx, tid, &mapped, &unmapped) == 0 && mapped + unmapped == 0)
+                continue;
+
+            hts_pos_t len = hdr.seq_length(tid);
+            for (hts_pos_t beg = 0; beg < len; beg += resolution) {
+                bytes[tid].push_back(_window_bytes(idx, tid, beg, std::min(beg + resolution, len)));
+                total += bytes[tid].back();
+            }
+        }
+
+        // Cut a shard once it has the bytes of the target, or at the end of sequence.
+        int64_t target = std::max(total / (int64_t)n_shards, (int64_t)1);
+        std::vector<GenomeRegion> shards;
+        for (int tid = 0; tid < n; ++tid) {
+
+            hts_pos_t len = hdr.seq_length(tid), beg = 0;
+            int64_t acc = 0;
+            for (size_t w = 0; w < bytes[tid].size(); ++w) {
+                acc += bytes[tid][w];
+                hts_pos_t end = std::min((hts_pos_t)(w + 1) * resolution, len);
+                if (acc >= target || (end == len && acc > 0)) {
+                    shards.push_back(GenomeRegion(tid, beg, end));
+                    beg = end;
+                    acc = 0;
+                }
+            }
+
+            // The empty windows at the end belong to the last shard.
+            if (beg > 0 && beg < len) shards.back().end = len;
+        }
+
+        return shards;
+    }
+
+    std::ostream &operator<<(std::ostream &os, const IndexStats &s) {
+
+        for (size_t i = 0; i < s.contigs.size(); ++i) {
+            const ContigStats &c = s.contigs[i];
+            os << c.name << "\t" << c.length << "\t" << c.mapped << "\t" << c.unmapped << "\n";
+        }
+        os << "*\t0\t0\t" << s.n_no_coor << "\n";
+
+        return os;
+    }
+
+}  // namespace ngslib
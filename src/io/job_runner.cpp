@@ -0,0 +1,33 @@
+#include <thread>
+#include <vector>
+#include <exception>
+
+#include "ngslib/job_runner.h"
+
+namespace ngslib {
+
+    void JobRunner::run(size_t n_worker, const std::function<void(int worker_id)> &worker) {
+
+        std::vector<std::exception_ptr> errors(n_worker);
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < n_worker; ++i) {
+            workers.push_back(std::thread([this, i, &worker, &errors]() {
+                try {
+                    worker(i);
+                } catch (...) {
+                    errors[i] = std::current_exception();
+                    _abort = true;  // Stop the others as soon as possible.
+                }
+            }));
+        }
+
+        for (size_t i = 0; i < n_worker; ++i) {
+            workers[i].join();
+        }
+
+        for (size_t i = 0; i < n_worker; ++i) {
+            if (errors[i]) std::rethrow_exception(errors[i]);
+        }
+    }
+
+}  // namespace ngslib
@@ -0,0 +1,427 @@
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include <htslib/sam.h>
+#include <htslib/bgzf.h>
+#include "ngslib/mate_pairer.h"
+#include "ngslib/utils.h"
+
+namespace ngslib {
+
+    MatePairer::MatePairer(size_t max_pending, hts_pos_t max_distance) :
+            _max_pending(max_pending), _max_distance(max_distance), _n_partitions(16),
+            _n_pending(0), _spill_fields(Fields::ALL), _next_partition(0), _last_tid(0),
+            _last_pos(-1), _full_tid(0), _full_pos(-1), _finished(false), _n_pairs(0),
+            _n_orphans(0), _n_spilled(0), _n_skipped(0) {
+
+        if (max_pending == 0) {
+            throw std::invalid_argument("[mate_pairer.cpp::MatePairer] max_pending must be > 0.");
+        }
+
+        const char *tmp = std::getenv("TMPDIR");
+        _tmp_dir = (tmp && *tmp) ? tmp : "/tmp";
+    }
+
+    MatePairer::~MatePairer() {
+
+        reset();
+        for (size_t i = 0; i < _spare.size(); ++i) {
+            bam_destroy1(_spare[i]);
+        }
+    }
+
+    void MatePairer::set_partitions(size_t n) {
+
+        if (n == 0 || !_spill.empty()) {
+            throw std::invalid_argument("[mate_pairer.cpp::MatePairer:set_partitions] The number of "
+                                        "partitions must be > 0 and set before spilling.");
+        }
+        _n_partitions = n;
+    }
+
+    uint64_t MatePairer::_hash(const bam1_t *b) {
+
+        // FNV-1a
+        uint64_t h = 14695981039346656037ULL;
+        for (const char *p = bam_get_qname(b); *p; ++p) {
+            h = (h ^ (unsigned char)(*p)) * 1099511628211ULL;
+        }
+        return h;
+    }
+
+    bam1_t *MatePairer::_new_record() {
+
+        if (_spare.empty()) return bam_init1();
+
+        bam1_t *b = _spare.back();
+        _spare.pop_back();
+        return b;
+    }
+
+    void MatePairer::_recycle(bam1_t *b) {
+        _spare.push_back(b);
+    }
+
+    long MatePairer::_find(const bam1_t *b, uint64_t h) const {
+
+        if (_slots.empty()) return -1;
+
+        size_t mask = _slots.size() - 1;
+        for (size_t i = h & mask; _slots[i]; i = (i + 1) & mask) {
+            if (_hashes[i] == h && std::strcmp(bam_get_qname(_pool[_slots[i] - 1].b), bam_get_qname(b)) == 0) {
+                return (long)i;
+            }
+        }
+        return -1;
+    }
+
+    size_t MatePairer::_slot_of(uint32_t idx) const {
+
+        size_t mask = _slots.size() - 1;
+        size_t i = _pool[idx].hash & mask;
+        while (_slots[i] != idx + 1) i = (i + 1) & mask;
+
+        return i;
+    }
+
+    void MatePairer::_grow() {
+
+        std::vector<uint32_t> slots(_slots.empty() ? 1024 : 2 * _slots.size(), 0);
+        std::vector<uint64_t> hashes(slots.size(), 0);
+
+        size_t mask = slots.size() - 1;
+        for (size_t i = 0; i < _slots.size(); ++i) {
+            if (!_slots[i]) continue;
+
+            size_t j = _hashes[i] & mask;
+            while (slots[j]) j = (j + 1) & mask;
+            slots[j] = _slots[i];
+            hashes[j] = _hashes[i];
+        }
+
+        _slots.swap(slots);
+        _hashes.swap(hashes);
+    }
+
+    void MatePairer::_erase(size_t slot) {
+
+        // Backward shift deletion: move the following records of the probe
+        // chain into the hole, unless they are already at or after their home.
+        size_t mask = _slots.size() - 1;
+        size_t i = slot;
+        for (size_t j = (i + 1) & mask; _slots[j]; j = (j + 1) & mask) {
+            size_t k = _hashes[j] & mask;
+            bool stay = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+            if (stay) continue;
+
+            _slots[i] = _slots[j];
+            _hashes[i] = _hashes[j];
+            i = j;
+        }
+
+        _slots[i] = 0;
+        --_n_pending;
+    }
+
+    uint32_t MatePairer::_wait(bam1_t *b, int fields, uint64_t h) {
+
+        if ((_n_pending + 1) * 2 > _slots.size()) _grow();  // Keep load factor <= 0.5
+
+        uint32_t idx;
+        if (_free.empty()) {
+            idx = _pool.size();
+            _pool.push_back(_Pending());
+            _pool[idx].gen = 0;
+        } else {
+            idx = _free.back();
+            _free.pop_back();
+        }
+
+        _Pending &p = _pool[idx];
+        p.b = b;
+        p.fields = fields;
+        p.hash = h;
+        ++p.gen;
+
+        size_t mask = _slots.size() - 1;
+        size_t i = h & mask;
+        while (_slots[i]) i = (i + 1) & mask;
+        _slots[i] = idx + 1;
+        _hashes[i] = h;
+        ++_n_pending;
+
+        return idx;
+    }
+
+    void MatePairer::_make_pair(size_t slot, bam1_t *b, int fields) {
+
+        uint32_t idx = _slots[slot] - 1;
+        _Pending &p = _pool[idx];
+
+        _Pair pair;
+        if ((b->core.flag & BAM_FREAD1) && !(p.b->core.flag & BAM_FREAD1)) {
+            pair.b1 = b;
+            pair.f1 = fields;
+            pair.b2 = p.b;
+            pair.f2 = p.fields;
+        } else {
+            pair.b1 = p.b;
+            pair.f1 = p.fields;
+            pair.b2 = b;
+            pair.f2 = fields;
+        }
+        _ready.push_back(pair);
+        ++_n_pairs;
+
+        p.b = NULL;
+        _free.push_back(idx);
+        _erase(slot);
+    }
+
+    void MatePairer::_drop(size_t slot) {
+
+        uint32_t idx = _slots[slot] - 1;
+        _recycle(_pool[idx].b);
+        _pool[idx].b = NULL;
+        _free.push_back(idx);
+        _erase(slot);
+
+        ++_n_orphans;
+    }
+
+    void MatePairer::_clear_table(bool orphan) {
+
+        for (size_t i = 0; i < _slots.size(); ++i) {
+            if (!_slots[i]) continue;
+
+            uint32_t idx = _slots[i] - 1;
+            _recycle(_pool[idx].b);
+            _pool[idx].b = NULL;
+            _free.push_back(idx);
+            _slots[i] = 0;
+
+            if (orphan) ++_n_orphans;
+        }
+
+        _n_pending = 0;
+        while (!_deadlines.empty()) _deadlines.pop();
+    }
+
+    void MatePairer::_open_spill() {
+
+        for (size_t i = 0; i < _n_partitions; ++i) {
+
+            // The file is unlinked at once, so it goes away with the descriptor.
+            std::string fn = _tmp_dir + "/ngslib_mate_pairer.XXXXXX";
+            int fd = mkstemp(&fn[0]);
+            if (fd < 0) {
+                throw std::invalid_argument("[mate_pairer.cpp::MatePairer:_open_spill] Fail to create "
+                                            "temporary file in " + _tmp_dir);
+            }
+            unlink(fn.c_str());
+            _spill_fd.push_back(fd);
+
+            // Write by a duplicated descriptor, which is closed with the BGZF,
+            // and read the file back by the kept one.
+            BGZF *fp = bgzf_dopen(dup(fd), "w1");
+            if (!fp) {
+                throw std::invalid_argument("[mate_pairer.cpp::MatePairer:_open_spill] Fail to open "
+                                            "temporary file in " + _tmp_dir);
+            }
+            _spill.push_back(fp);
+        }
+    }
+
+    void MatePairer::_spill_record(bam1_t *b, int fields, uint64_t h) {
+
+        if (_spill.empty()) _open_spill();
+
+        // The high bits pick the partition, as the low ones are the slot of
+        // the table in _pair_partition(): all the reads of a partition would
+        // share them and pile up in the same run of slots.
+        if (bam_write1(_spill[(h >> 32) % _spill.size()], b) < 0) {
+            throw std::invalid_argument("[mate_pairer.cpp::MatePairer:_spill_record] Fail to write "
+                                        "temporary file in " + _tmp_dir);
+        }
+
+        _spill_fields &= fields;
+        ++_n_spilled;
+        _recycle(b);
+    }
+
+    void MatePairer::_close_spill() {
+
+        for (size_t i = 0; i < _spill.size(); ++i) {
+            if (_spill[i]) bgzf_close(_spill[i]);
+            if (_spill_fd[i] >= 0) close(_spill_fd[i]);
+        }
+
+        _spill.clear();
+        _spill_fd.clear();
+        _next_partition = 0;
+    }
+
+    void MatePairer::push(BamRecord &br) {
+
+        if (_finished) {
+            throw std::invalid_argument("[mate_pairer.cpp::MatePairer:push] The stream has been "
+                                        "finished, call reset() first.");
+        }
+
+        const bam1_t *b = br.b();
+        if (!b) return;
+
+        uint32_t tid = b->core.tid;
+        hts_pos_t pos = b->core.pos;
+        if (tid < _last_tid || (tid == _last_tid && pos < _last_pos)) {
+            throw std::invalid_argument("[mate_pairer.cpp::MatePairer:push] The stream is not sorted "
+                                        "by coordinate: " + br.qname());
+        }
+        _last_tid = tid;
+        _last_pos = pos;
+
+        // The stream has passed the mates of these records.
+        while (!_deadlines.empty() && (_deadlines.top().tid < tid ||
+                                       (_deadlines.top().tid == tid && _deadlines.top().pos < pos))) {
+            _Deadline d = _deadlines.top();
+            _deadlines.pop();
+            if (_pool[d.idx].b && _pool[d.idx].gen == d.gen) _drop(_slot_of(d.idx));
+        }
+
+        if (!(b->core.flag & BAM_FPAIRED) || (b->core.flag & (BAM_FSECONDARY | BAM_FSUPPLEMENTARY))) {
+            ++_n_skipped;
+            return;
+        }
+
+        // Take the record without copying.
+        int fields = br.fields();
+        bam1_t *rec = br.exchange(_new_record(), fields);
+
+        uint64_t h = _hash(rec);
+        long slot = _find(rec, h);
+        if (slot >= 0) {
+            _make_pair(slot, rec, fields);
+            return;
+        }
+
+        // The mate is ahead of (or at the same position as) this record.
+        uint32_t mtid = rec->core.mtid;
+        hts_pos_t mpos = rec->core.mpos;
+        bool ahead = mtid > tid || (mtid == tid && mpos >= pos);
+        bool same_pos = mtid == tid && mpos == pos;
+
+        if (same_pos && tid == _full_tid && pos == _full_pos) {
+            _spill_record(rec, fields, h);
+
+        } else if (ahead && mtid == tid && mpos - pos <= _max_distance && _n_pending < _max_pending) {
+            _Deadline d;
+            d.tid = mtid;
+            d.pos = mpos;
+            d.idx = _wait(rec, fields, h);
+            d.gen = _pool[d.idx].gen;
+            _deadlines.push(d);
+
+        } else {
+            // Far away, on another reference, or the table is full. The mate
+            // behind could only be spilled if it's not an orphan.
+            if (same_pos) {
+                _full_tid = tid;
+                _full_pos = pos;
+            }
+            _spill_record(rec, fields, h);
+        }
+    }
+
+    void MatePairer::finish() {
+
+        if (_finished) return;
+
+        _clear_table(true);  // No mate would come any more.
+        for (size_t i = 0; i < _spill.size(); ++i) {
+
+            int ret = bgzf_close(_spill[i]);
+            _spill[i] = NULL;
+            if (ret < 0 || lseek(_spill_fd[i], 0, SEEK_SET) < 0) {
+                throw std::invalid_argument("[mate_pairer.cpp::MatePairer:finish] Fail to write "
+                                            "temporary file in " + _tmp_dir);
+            }
+
+            // The descriptor is owned by the BGZF now.
+            _spill[i] = bgzf_dopen(_spill_fd[i], "r");
+            if (!_spill[i]) {
+                throw std::invalid_argument("[mate_pairer.cpp::MatePairer:finish] Fail to read "
+                                            "temporary file in " + _tmp_dir);
+            }
+            _spill_fd[i] = -1;
+        }
+
+        _next_partition = 0;
+        _finished = true;
+    }
+
+    int MatePairer::_pair_partition() {
+
+        BGZF *fp = _spill[_next_partition];
+        bam1_t *b = _new_record();
+        int ret;
+        while ((ret = bam_read1(fp, b)) >= 0) {
+
+            uint64_t h = _hash(b);
+            long slot = _find(b, h);
+            if (slot >= 0) {
+                _make_pair(slot, b, _spill_fields);
+            } else {
+                _wait(b, _spill_fields, h);
+            }
+            b = _new_record();
+        }
+        _recycle(b);
+
+        _clear_table(ret == -1);
+        bgzf_close(fp);
+        _spill[_next_partition++] = NULL;
+
+        return ret == -1 ? 0 : ret;
+    }
+
+    int MatePairer::pop(BamRecord &read1, BamRecord &read2) {
+
+        while (_ready.empty() && _finished && _next_partition < _spill.size()) {
+            int ret = _pair_partition();
+            if (ret < -1) return ret;
+        }
+
+        if (_ready.empty()) return -1;
+
+        _Pair p = _ready.front();
+        _ready.pop_front();
+
+        bam1_t *old = read1.exchange(p.b1, p.f1);
+        if (old) _recycle(old);
+
+        old = read2.exchange(p.b2, p.f2);
+        if (old) _recycle(old);
+
+        return 0;
+    }
+
+    void MatePairer::reset() {
+
+        _clear_table(false);
+        while (!_ready.empty()) {
+            _recycle(_ready.front().b1);
+            _recycle(_ready.front().b2);
+            _ready.pop_front();
+        }
+        _close_spill();
+
+        _spill_fields = Fields::ALL;
+        _last_tid = _full_tid = 0;
+        _last_pos = _full_pos = -1;
+        _finished = false;
+        _n_pairs = _n_orphans = _n_spilled = _n_skipped = 0;
+    }
+
+}  // namespace ngslib
@@ -0,0 +1,248 @@
+#include <stdexcept>
+#include <utility>
+
+#include <htslib/bgzf.h>
+#include "ngslib/multi_bam.h"
+
+namespace ngslib {
+
+    // Coordinate order without strand, which is all that a coordinate-sorted
+    // input must follow.
+    static bool _coordinate_less(const bam1_t *a, const bam1_t *b) {
+
+        uint32_t ta = a->core.tid, tb = b->core.tid;
+        if (ta != tb) return ta < tb;
+        return a->core.pos < b->core.pos;
+    }
+
+    MultiBam::MultiBam(const std::vector<std::string> &fns, size_t max_open, size_t buffer_size) :
+            _max_open(max_open), _buffer_size(buffer_size), _n_open(0), _tick(0),
+            _order(SortOrder::COORDINATE), _started(false), _source(0), _io_status(0) {
+
+        if (fns.empty()) {
+            throw std::invalid_argument("[multi_bam.cpp::MultiBam] No input file.");
+        }
+        if (buffer_size == 0) {
+            throw std::invalid_argument("[multi_bam.cpp::MultiBam] buffer_size must be > 0.");
+        }
+
+        for (size_t i = 0; i < fns.size(); ++i) {
+            _sources.push_back(std::unique_ptr<_Source>(new _Source(fns[i])));
+        }
+    }
+
+    void MultiBam::set_order(int order) {
+
+        if ((order != SortOrder::COORDINATE && order != SortOrder::QUERYNAME) || _started) {
+            throw std::invalid_argument("[multi_bam.cpp::MultiBam:set_order] Unknown order, or "
+                                        "it's set after reading.");
+        }
+        _order = order;
+    }
+
+    BamHeader &MultiBam::header() {
+        if (!_hdr) {
+            _hdr = BamHeader(_sources[0]->fname);
+        }
+        return _hdr;
+    }
+
+    MultiBam &MultiBam::fetch(const std::string &region) {
+
+        // Drop everything, the files are re-opened and fetched lazily.
+        for (size_t i = 0; i < _sources.size(); ++i) {
+            _Source &s = *_sources[i];
+            s.bam.reset();
+            if (s.itr) sam_itr_destroy(s.itr);
+            s.itr = NULL;
+            s.offset = -1;
+            s.eof = false;
+            s.buffer.clear();
+            s.next = 0;
+        }
+
+        _n_open = 0;
+        _region = region;
+        _started = false;
+        _io_status = 0;
+
+        return *this;
+    }
+
+    void MultiBam::_check_header(size_t i) {
+
+        if (!_sources[i]->bam->header().same_sequences(header())) {
+            throw std::invalid_argument("[multi_bam.cpp::MultiBam:_check_header] The reference "
+                                        "sequences of " + _sources[i]->fname + " are different "
+                                        "from " + _sources[0]->fname);
+        }
+    }
+
+    void MultiBam::_open(size_t i) {
+
+        _Source &s = *_sources[i];
+        s.last_use = ++_tick;
+        if (s.bam) return;
+
+        if (_max_open > 0 && _n_open >= _max_open) _close_lru(i);
+
+        s.bam.reset(new Bam(s.fname, "r"));
+        ++_n_open;
+        if (_tpool) s.bam->set_thread_pool(_tpool);
+
+        if (!s.checked) {
+            _check_header(i);
+            s.checked = true;
+        }
+
+        if (s.offset >= 0) {
+            // Resume a closed BAM: the header has been read by _check_header()
+            // or header(), jump to where it stopped and go on with its iterator.
+            s.bam->header();
+            s.bam->_itr = s.itr;
+            s.itr = NULL;
+
+            if (bgzf_seek(s.bam->_fp->fp.bgzf, s.offset, SEEK_SET) < 0) {
+                throw std::invalid_argument("[multi_bam.cpp::MultiBam:_open] Fail to "
+                                            "resume reading " + s.fname);
+            }
+            s.offset = -1;
+
+        } else if (!_region.empty()) {
+            s.bam->fetch(_region);
+        }
+    }
+
+    void MultiBam::_close_lru(size_t keep) {
+
+        size_t lru = _sources.size();
+        for (size_t i = 0; i < _sources.size(); ++i) {
+
+            const _Source &s = *_sources[i];
+            if (i == keep || !s.bam) continue;
+
+            // Only BGZF compressed BAM could be resumed by virtual offset.
+            if (hts_get_format(s.bam->_fp)->format != bam) continue;
+            if (lru == _sources.size() || s.last_use < _sources[lru]->last_use) lru = i;
+        }
+
+        if (lru == _sources.size()) return;  // Nothing could be closed, go beyond max_open.
+
+        _Source &s = *_sources[lru];
+        s.offset = bgzf_tell(s.bam->_fp->fp.bgzf);
+        s.itr = s.bam->_itr;  // Keep the position in the index chunks.
+        s.bam->_itr = NULL;
+
+        s.bam.reset();
+        --_n_open;
+    }
+
+    int MultiBam::_fill(size_t i) {
+
+        _Source &s = *_sources[i];
+        if (s.next < s.buffer.size() || s.eof) return 0;
+
+        _open(i);
+        s.next = 0;
+        if (s.bam->read_batch(s.buffer, _buffer_size) < _buffer_size) {
+
+            int status = s.bam->io_status();
+            s.eof = true;
+            s.bam.reset();  // Close it right now to release the file handle.
+            --_n_open;
+
+            if (status < -1) return status;
+        }
+
+        return 0;
+    }
+
+    bool MultiBam::_before(size_t a, size_t b) const {
+
+        // _sources.size() is the sentinel which goes before all, see _start().
+        if (a == _sources.size()) return true;
+        if (b == _sources.size()) return false;
+
+        const _Source &sa = *_sources[a], &sb = *_sources[b];
+        if (sa.exhausted()) return false;
+        if (sb.exhausted()) return true;
+
+        const bam1_t *x = sa.buffer[sa.next].b(), *y = sb.buffer[sb.next].b();
+        bool (*less)(const bam1_t *, const bam1_t *) = _order == SortOrder::QUERYNAME ? queryname_less
+                                                                                        : coordinate_less;
+        if (less(x, y)) return true;
+        if (less(y, x)) return false;
+
+        return a < b;  // Keep the order of input for ties.
+    }
+
+    void MultiBam::_adjust(size_t s) {
+
+        // The leaf of source s is at s + k, and the internal node t keeps the
+        // loser of the match between its two children.
+        for (size_t t = (s + _sources.size()) / 2; t > 0; t /= 2) {
+            if (_before(_tree[t], s)) std::swap(s, _tree[t]);
+        }
+        _tree[0] = s;
+    }
+
+    void MultiBam::_start() {
+
+        for (size_t i = 0; i < _sources.size(); ++i) {
+            _io_status = _fill(i);
+            if (_io_status < -1) return;
+        }
+
+        // Fill the tree with sentinels, they are pushed out by the real sources.
+        _tree.assign(_sources.size(), _sources.size());
+        for (size_t i = _sources.size(); i-- > 0;) {
+            _adjust(i);
+        }
+
+        _started = true;
+    }
+
+    int MultiBam::read(BamRecord &br) {
+
+        if (!_started) {
+            _start();
+            if (_io_status < -1) {
+                br.destroy();
+                return _io_status;
+            }
+        }
+
+        size_t w = _tree[0];
+        _Source &s = *_sources[w];
+        if (s.exhausted()) {  // The winner is exhausted, so are all the others.
+            br.destroy();
+            return _io_status = -1;
+        }
+
+        // Take the head record without copy, and give the old one of br back.
+        bam1_t *old = br.exchange(NULL);
+        br.exchange(s.buffer[s.next].exchange(old));
+        ++s.next;
+        _source = w;
+
+        _io_status = _fill(w);
+        if (_io_status < -1) {
+            br.destroy();
+            return _io_status;
+        }
+
+        // The strand is only used for merging, the inputs sorted by (tid, pos)
+        // are fine.
+        if (!s.exhausted()) {
+            const bam1_t *b = s.buffer[s.next].b();
+            if (_order == SortOrder::QUERYNAME ? queryname_less(b, br.b()) : _coordinate_less(b, br.b())) {
+                throw std::invalid_argument("[multi_bam.cpp::MultiBam:read] " + s.fname + " is not "
+                                            "sorted.");
+            }
+        }
+
+        _adjust(w);
+        return _io_status;
+    }
+
+}  // namespace ngslib
@@ -0,0 +1,111 @@
+#include <stdexcept>
+#include <chrono>
+
+#include "ngslib/prefetch_reader.h"
+
+namespace ngslib {
+
+    // Spin a while and then sleep, to wait for the other side of the ring.
+    static void _backoff(unsigned int &spin) {
+        if (++spin < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+    PrefetchReader::PrefetchReader(size_t depth) : _head(0), _tail(0), _stop(false), _fp(NULL),
+                                                   _hdr(NULL), _itr(NULL), _running(false),
+                                                   _end_status(0) {
+        if (depth == 0) {
+            throw std::invalid_argument("[prefetch_reader.cpp::PrefetchReader] depth must be > 0.");
+        }
+
+        _ring.resize(depth);
+        for (size_t i = 0; i < depth; ++i) {
+            _ring[i].b = bam_init1();
+            _ring[i].status = 0;
+        }
+    }
+
+    PrefetchReader::~PrefetchReader() {
+        stop();
+        for (size_t i = 0; i < _ring.size(); ++i) bam_destroy1(_ring[i].b);
+    }
+
+    void PrefetchReader::start(samFile *fp, sam_hdr_t *hdr, hts_itr_t *itr, const ReadFilter &filter) {
+
+        stop();
+        _fp = fp;
+        _hdr = hdr;
+        _itr = itr;
+        _filter = filter;
+
+        _running = true;
+        _producer = std::thread(&PrefetchReader::_produce, this);
+    }
+
+    void PrefetchReader::stop() {
+
+        if (_producer.joinable()) {
+            _stop = true;
+            _producer.join();
+        }
+
+        _stop = false;
+        _head = 0;
+        _tail = 0;
+        _running = false;
+        _end_status = 0;
+    }
+
+    void PrefetchReader::_produce() {
+
+        size_t n = _ring.size();
+        unsigned int spin = 0;
+        while (!_stop) {
+
+            size_t tail = _tail.load(std::memory_order_relaxed);
+            if (tail - _head.load(std::memory_order_acquire) == n) {  // Full
+                _backoff(spin);
+                continue;
+            }
+            spin = 0;
+
+            Slot &s = _ring[tail % n];
+            s.status = _itr ? sam_itr_next(_fp, _itr, s.b) : sam_read1(_fp, _hdr, s.b);
+            if (s.status >= 0 && !_filter.pass(s.b)) continue;  // Reuse the slot.
+
+            // Publish the slot to consumer.
+            _tail.store(tail + 1, std::memory_order_release);
+            if (s.status < 0) break;  // End of stream or error, nothing more to read.
+        }
+    }
+
+    int PrefetchReader::next(BamRecord &br, int fields) {
+
+        if (!_running) return -1;
+        if (_end_status < 0) return _end_status;  // Always the same status after the end.
+
+        size_t head = _head.load(std::memory_order_relaxed);
+        unsigned int spin = 0;
+        while (_tail.load(std::memory_order_acquire) == head) {  // Empty
+            _backoff(spin);
+        }
+
+        Slot &s = _ring[head % _ring.size()];
+        int status = s.status;
+        if (status >= 0) {
+            // Take the decoded bam1_t, and give the old one of br to the slot.
+            bam1_t *old = br.exchange(s.b, fields);
+            s.b = old ? old : bam_init1();
+        } else {
+            _end_status = status;
+        }
+
+        // Release the slot to producer.
+        _head.store(head + 1, std::memory_order_release);
+        return status;
+    }
+
+}  // namespace ngslib
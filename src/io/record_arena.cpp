@@ -0,0 +1,98 @@
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+
+#include "ngslib/record_arena.h"
+
+namespace ngslib {
+
+    static inline size_t _align8(size_t n) { return (n + 7) & ~(size_t)7; }
+
+    RecordArena::RecordArena(size_t slab_size) : _slab_size(slab_size), _cur(0), _off(0), _bytes_used(0) {
+        if (slab_size == 0)
+            throw std::invalid_argument("[record_arena.cpp::RecordArena:RecordArena] slab_size must be > 0.");
+    }
+
+    uint8_t *RecordArena::_alloc(size_t n) {
+
+        n = _align8(n);
+        while (_cur < _slabs.size() && _off + n > _slabs[_cur].size) {
+            ++_cur;  // The rest of a full slab is left unused.
+            _off = 0;
+        }
+
+        if (_cur == _slabs.size()) {
+            _Slab s;
+            s.size = n > _slab_size ? n : _slab_size;
+            s.mem = (uint8_t *) malloc(s.size);  // malloc() is aligned for bam1_t.
+            if (!s.mem)
+                throw std::runtime_error("[record_arena.cpp::RecordArena:_alloc] Out of memory.");
+
+            _slabs.push_back(s);
+            _off = 0;
+        }
+
+        uint8_t *p = _slabs[_cur].mem + _off;
+        _off += n;
+        _bytes_used += n;
+
+        return p;
+    }
+
+    bam1_t *RecordArena::add(const bam1_t *b, int fields) {
+
+        if (!b)
+            throw std::invalid_argument("[record_arena.cpp::RecordArena:add] NULL record.");
+
+        // One block for both of the struct and the data, so they stay together.
+        uint8_t *p = _alloc(_align8(sizeof(bam1_t)) + b->l_data);
+
+        bam1_t *a = (bam1_t *) p;
+        memcpy(a, b, sizeof(bam1_t));
+        a->data = p + _align8(sizeof(bam1_t));
+        a->m_data = b->l_data;
+        if (b->l_data > 0) memcpy(a->data, b->data, b->l_data);
+        bam_set_mempolicy(a, BAM_USER_OWNS_STRUCT | BAM_USER_OWNS_DATA);
+
+        _Entry e;
+        e.b = a;
+        e.fields = fields;
+        _records.push_back(e);
+
+        return a;
+    }
+
+    BamRecord RecordArena::record(size_t i) const {
+        BamRecord br;
+        br.exchange(_records[i].b, _records[i].fields);  // br was empty, nothing to free.
+
+        return br;
+    }
+
+    void RecordArena::clear() {
+        _records.clear();
+        _cur = 0;
+        _off = 0;
+        _bytes_used = 0;
+    }
+
+    void RecordArena::release() {
+        for (size_t i = 0; i < _slabs.size(); ++i)
+            free(_slabs[i].mem);
+
+        std::vector<_Slab>().swap(_slabs);
+        std::vector<_Entry>().swap(_records);
+        _cur = 0;
+        _off = 0;
+        _bytes_used = 0;
+    }
+
+    size_t RecordArena::bytes_allocated() const {
+        size_t n = _slabs.capacity() * sizeof(_Slab) + _records.capacity() * sizeof(_Entry);
+        for (size_t i = 0; i < _slabs.size(); ++i)
+            n += _slabs[i].size;
+
+        return n;
+    }
+
+}  // namespace ngslib
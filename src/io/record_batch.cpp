@@ -0,0 +1,25 @@
+#include "ngslib/record_batch.h"
+
+namespace ngslib {
+
+    void RecordBatch::reserve(size_t n) {
+
+        if (n <= _records.size())
+            return;
+
+        _records.reserve(n);
+        while (_records.size() < n) {
+            _records.push_back(BamRecord());
+            _records.back().init();  // Allocate bam1_t for the new slot.
+        }
+    }
+
+    BamRecord &RecordBatch::_free_slot() {
+
+        if (_size == _records.size())
+            reserve(_size + 1);
+
+        return _records[_size];
+    }
+
+}  // namespace ngslib
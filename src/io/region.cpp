@@ -0,0 +1,152 @@
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+
+#include <htslib/sam.h>
+#include <htslib/kstring.h>
+#include "ngslib/region.h"
+#include "ngslib/utils.h"
+
+namespace ngslib {
+
+    std::string GenomeRegion::to_string(const BamHeader &hdr) const {
+
+        if (tid == HTS_IDX_NOCOOR) return "*";
+
+        // Use the `{REF}:` form if the reference name itself contains a colon.
+        std::string name = hdr.seq_name(tid);
+        if (name.find(':') != std::string::npos) name = "{" + name + "}";
+
+        return name + ":" + tostring(beg + 1) + "-" + tostring(end);
+    }
+
+    std::vector<GenomeRegion> parse_regions(const BamHeader &hdr,
+                                            const std::vector<std::string> &regions) {
+
+        std::vector<GenomeRegion> parsed;
+        for (size_t i = 0; i < regions.size(); ++i) {
+
+            int tid;
+            hts_pos_t beg, end;
+            if (!sam_parse_region(hdr.h(), regions[i].c_str(), &tid, &beg, &end, 0)) {
+                throw std::invalid_argument("[region.cpp::parse_regions] Fail to parse "
+                                            "region: " + regions[i]);
+            }
+
+            if (tid == HTS_IDX_START) {  // '.', all the reads from the start of file.
+                std::vector<GenomeRegion> all = split_genome(hdr, HTS_POS_MAX);
+                parsed.insert(parsed.end(), all.begin(), all.end());
+                parsed.push_back(GenomeRegion(HTS_IDX_NOCOOR, 0, 0));
+
+            } else if (tid == HTS_IDX_NOCOOR) {  // '*'
+                parsed.push_back(GenomeRegion(HTS_IDX_NOCOOR, 0, 0));
+
+            } else if (tid >= 0) {
+                end = std::min(end, hdr.seq_length(tid));
+                if (beg < end) parsed.push_back(GenomeRegion(tid, beg, end));
+
+            } else {
+                throw std::invalid_argument("[region.cpp::parse_regions] Unknown reference "
+                                            "name in region: " + regions[i]);
+            }
+        }
+
+        return parsed;
+    }
+
+    std::vector<GenomeRegion> load_bed(const BamHeader &hdr, const std::string &bed_fn) {
+
+        if (!is_readable(bed_fn)) {
+            throw std::invalid_argument("[region.cpp::load_bed] file not found - " + bed_fn);
+        }
+
+        htsFile *fp = hts_open(bed_fn.c_str(), "r");
+        if (!fp) {
+            throw std::invalid_argument("[region.cpp::load_bed] file open failure - " + bed_fn);
+        }
+
+        std::vector<GenomeRegion> regions;
+        kstring_t line = {0, 0, NULL};
+        size_t n_line = 0;
+        while (hts_getline(fp, KS_SEP_LINE, &line) >= 0) {
+            ++n_line;
+            if (line.l == 0 || line.s[0] == '#' ||
+                strncmp(line.s, "track", 5) == 0 || strncmp(line.s, "browser", 7) == 0)
+                continue;
+
+            // CHROM, START and END are separated by tab or space.
+            char *p = line.s, *q;
+            while (*p && !isspace(*p)) ++p;
+            std::string chrom(line.s, p - line.s);
+
+            hts_pos_t beg = strtoll(p, &q, 10);
+            bool good = (q != p);
+
+            p = q;
+            hts_pos_t end = strtoll(p, &q, 10);
+            good = good && (q != p);
+
+            int tid = sam_hdr_name2tid(hdr.h(), chrom.c_str());
+            if (!good || tid < 0 || beg < 0) {
+                ks_free(&line);
+                hts_close(fp);
+                throw std::invalid_argument("[region.cpp::load_bed] Bad BED line " +
+                                            tostring(n_line) + " or unknown reference "
+                                            "name in " + bed_fn + ": " + chrom);
+            }
+
+            end = std::min(end, hdr.seq_length(tid));
+            if (beg < end) regions.push_back(GenomeRegion(tid, beg, end));
+        }
+
+        ks_free(&line);
+        hts_close(fp);
+        return regions;
+    }
+
+    static bool _region_less(const GenomeRegion &a, const GenomeRegion &b) {
+        // Unmapped reads (tid < 0) are always at the end of file.
+        if (a.tid != b.tid) return (uint32_t) a.tid < (uint32_t) b.tid;
+        return a.beg < b.beg;
+    }
+
+    std::vector<GenomeRegion> merge_regions(std::vector<GenomeRegion> regions,
+                                            hts_pos_t merge_gap) {
+
+        std::sort(regions.begin(), regions.end(), _region_less);
+
+        std::vector<GenomeRegion> merged;
+        for (size_t i = 0; i < regions.size(); ++i) {
+            if (!merged.empty() && merged.back().tid == regions[i].tid &&
+                regions[i].beg <= merged.back().end + merge_gap)
+            {
+                merged.back().end = std::max(merged.back().end, regions[i].end);
+            } else {
+                merged.push_back(regions[i]);
+            }
+        }
+
+        return merged;
+    }
+
+    std::vector<GenomeRegion> split_genome(const BamHeader &hdr, hts_pos_t shard_size) {
+
+        if (shard_size <= 0) {
+            throw std::invalid_argument("[region.cpp::split_genome] shard_size must "
+                                        "be > 0, but got: " + tostring(shard_size));
+        }
+
+        std::vector<GenomeRegion> shards;
+        for (int tid = 0; tid < hdr.h()->n_targets; ++tid) {
+            hts_pos_t len = hdr.seq_length(tid);
+            for (hts_pos_t beg = 0; beg < len; beg += shard_size) {
+                shards.push_back(GenomeRegion(tid, beg, std::min(beg + shard_size, len)));
+            }
+        }
+
+        return shards;
+    }
+
+}  // namespace ngslib
@@ -0,0 +1,282 @@
+#include "ngslib/seq_kernels.h"
+
+// The x86 kernels are compiled for their own target by function attributes,
+// so the library still runs on a CPU without them.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define NGSLIB_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace ngslib {
+
+    // 4-bit base to ASCII, the same as _BASES in bam_record.h, and to the
+    // ASCII of its complement.
+    static const char BASES[16] = {' ', 'A', 'C', ' ', 'G', ' ', ' ', ' ',
+                                   'T', ' ', ' ', ' ', ' ', ' ', ' ', 'N'};
+    static const char COMP_BASES[16] = {' ', 'T', 'G', ' ', 'C', ' ', ' ', ' ',
+                                        'A', ' ', ' ', ' ', ' ', ' ', ' ', 'N'};
+
+    static inline int _base(const uint8_t *seq, int i) {
+        return (seq[i >> 1] >> ((~i & 1) << 2)) & 0xf;  // bam_seqi()
+    }
+
+    static int _detect_simd() {
+#ifdef NGSLIB_X86_DISPATCH
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("ssse3")) return SimdLevel::SSSE3;
+#endif
+        return SimdLevel::SCALAR;
+    }
+
+    int simd_level() {
+        static const int level = _detect_simd();  // Thread-safe initialization in C++11.
+        return level;
+    }
+
+#ifdef NGSLIB_X86_DISPATCH
+
+    /* Each byte holds two bases, the first one in the upper 4 bits. The
+     * nibbles are split and interleaved back into one base per byte, then
+     * mapped to ASCII by a 16-entry table lookup (pshufb).
+     *
+     * The SIMD kernels return the number of items done, the rest is left
+     * to the scalar code. With `reverse`, item i is written to out[n-1-i]. */
+
+    __attribute__((target("ssse3")))
+    static int _decode_bases_ssse3(const uint8_t *seq, int n, const char *table, bool reverse, char *out) {
+
+        const __m128i lut = _mm_loadu_si128((const __m128i *)table);
+        const __m128i mask = _mm_set1_epi8(0x0f);
+        const __m128i rev = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+        int i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(seq + i / 2));
+            __m128i hi = _mm_and_si128(_mm_srli_epi16(x, 4), mask);
+            __m128i lo = _mm_and_si128(x, mask);
+            __m128i a = _mm_shuffle_epi8(lut, _mm_unpacklo_epi8(hi, lo));  // Bases i ~ i+15
+            __m128i b = _mm_shuffle_epi8(lut, _mm_unpackhi_epi8(hi, lo));  // Bases i+16 ~ i+31
+
+            if (reverse) {
+                _mm_storeu_si128((__m128i *)(out + n - i - 16), _mm_shuffle_epi8(a, rev));
+                _mm_storeu_si128((__m128i *)(out + n - i - 32), _mm_shuffle_epi8(b, rev));
+            } else {
+                _mm_storeu_si128((__m128i *)(out + i), a);
+                _mm_storeu_si128((__m128i *)(out + i + 16), b);
+            }
+        }
+
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    static int _decode_bases_avx2(const uint8_t *seq, int n, const char *table, bool reverse, char *out) {
+
+        const __m256i lut = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)table));
+        const __m256i mask = _mm256_set1_epi8(0x0f);
+        const __m256i rev = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+        int i = 0;
+        for (; i + 64 <= n; i += 64) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(seq + i / 2));
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), mask);
+            __m256i lo = _mm256_and_si256(x, mask);
+
+            // unpack works in 128-bit lanes: u0 holds bases 0~15 and 32~47,
+            // u1 holds bases 16~31 and 48~63.
+            __m256i u0 = _mm256_unpacklo_epi8(hi, lo);
+            __m256i u1 = _mm256_unpackhi_epi8(hi, lo);
+            __m256i a = _mm256_shuffle_epi8(lut, _mm256_permute2x128_si256(u0, u1, 0x20));  // Bases i ~ i+31
+            __m256i b = _mm256_shuffle_epi8(lut, _mm256_permute2x128_si256(u0, u1, 0x31));  // Bases i+32 ~ i+63
+
+            if (reverse) {
+                // Reverse the bytes in each lane, then swap the two lanes.
+                a = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(a, rev), 0x4E);
+                b = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(b, rev), 0x4E);
+                _mm256_storeu_si256((__m256i *)(out + n - i - 32), a);
+                _mm256_storeu_si256((__m256i *)(out + n - i - 64), b);
+            } else {
+                _mm256_storeu_si256((__m256i *)(out + i), a);
+                _mm256_storeu_si256((__m256i *)(out + i + 32), b);
+            }
+        }
+
+        return i;
+    }
+
+    __attribute__((target("ssse3")))
+    static int _decode_quals_ssse3(const uint8_t *qual, int n, int offset, bool reverse, char *out) {
+
+        const __m128i off = _mm_set1_epi8((char)offset);
+        const __m128i rev = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+        int i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i x = _mm_add_epi8(_mm_loadu_si128((const __m128i *)(qual + i)), off);
+            if (reverse) {
+                _mm_storeu_si128((__m128i *)(out + n - i - 16), _mm_shuffle_epi8(x, rev));
+            } else {
+                _mm_storeu_si128((__m128i *)(out + i), x);
+            }
+        }
+
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    static int _decode_quals_avx2(const uint8_t *qual, int n, int offset, bool reverse, char *out) {
+
+        const __m256i off = _mm256_set1_epi8((char)offset);
+        const __m256i rev = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                             15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+
+        int i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i x = _mm256_add_epi8(_mm256_loadu_si256((const __m256i *)(qual + i)), off);
+            if (reverse) {
+                x = _mm256_permute4x64_epi64(_mm256_shuffle_epi8(x, rev), 0x4E);
+                _mm256_storeu_si256((__m256i *)(out + n - i - 32), x);
+            } else {
+                _mm256_storeu_si256((__m256i *)(out + i), x);
+            }
+        }
+
+        return i;
+    }
+
+    /* Sum by psadbw against 0, min by pminub, and a quality q < threshold
+     * iff min(q, threshold - 1) == q. `threshold` is in [0, 256] here. */
+
+    __attribute__((target("ssse3")))
+    static int _qual_stats_ssse3(const uint8_t *qual, int n, int threshold, QualStats &s) {
+
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i below = _mm_set1_epi8((char)(threshold - 1));
+        __m128i sum = zero, min = _mm_set1_epi8((char)0xff);
+
+        int i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(qual + i));
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(x, zero));
+            min = _mm_min_epu8(min, x);
+            __m128i le = _mm_cmpeq_epi8(_mm_min_epu8(x, below), x);
+            s.n_below += __builtin_popcount(_mm_movemask_epi8(le));
+        }
+
+        uint64_t sums[2];
+        uint8_t mins[16];
+        _mm_storeu_si128((__m128i *)sums, sum);
+        _mm_storeu_si128((__m128i *)mins, min);
+        s.sum += sums[0] + sums[1];
+        for (int k = 0; i > 0 && k < 16; ++k) {
+            if (s.min < 0 || mins[k] < s.min) s.min = mins[k];
+        }
+
+        return i;
+    }
+
+    __attribute__((target("avx2")))
+    static int _qual_stats_avx2(const uint8_t *qual, int n, int threshold, QualStats &s) {
+
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i below = _mm256_set1_epi8((char)(threshold - 1));
+        __m256i sum = zero, min = _mm256_set1_epi8((char)0xff);
+
+        int i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i *)(qual + i));
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(x, zero));
+            min = _mm256_min_epu8(min, x);
+            __m256i le = _mm256_cmpeq_epi8(_mm256_min_epu8(x, below), x);
+            s.n_below += __builtin_popcount((unsigned)_mm256_movemask_epi8(le));
+        }
+
+        uint64_t sums[4];
+        uint8_t mins[32];
+        _mm256_storeu_si256((__m256i *)sums, sum);
+        _mm256_storeu_si256((__m256i *)mins, min);
+        s.sum += sums[0] + sums[1] + sums[2] + sums[3];
+        for (int k = 0; i > 0 && k < 32; ++k) {
+            if (s.min < 0 || mins[k] < s.min) s.min = mins[k];
+        }
+
+        return i;
+    }
+
+#endif  // #ifdef NGSLIB_X86_DISPATCH
+
+    // The SIMD kernel decodes as many as it can, then the scalar code does the rest.
+    static void _decode_bases(const uint8_t *seq, int n, const char *table, bool reverse, char *out) {
+
+        int i = 0;
+#ifdef NGSLIB_X86_DISPATCH
+        switch (simd_level()) {
+            case SimdLevel::AVX2:  i = _decode_bases_avx2(seq, n, table, reverse, out); break;
+            case SimdLevel::SSSE3: i = _decode_bases_ssse3(seq, n, table, reverse, out); break;
+            default: break;
+        }
+#endif
+        if (reverse) {
+            for (; i < n; ++i) out[n - 1 - i] = table[_base(seq, i)];
+        } else {
+            for (; i < n; ++i) out[i] = table[_base(seq, i)];
+        }
+    }
+
+    void decode_bases(const uint8_t *seq, int n, char *out) {
+        _decode_bases(seq, n, BASES, false, out);
+    }
+
+    void decode_bases_revcomp(const uint8_t *seq, int n, char *out) {
+        _decode_bases(seq, n, COMP_BASES, true, out);
+    }
+
+    void decode_quals(const uint8_t *qual, int n, int offset, bool reverse, char *out) {
+
+        int i = 0;
+#ifdef NGSLIB_X86_DISPATCH
+        switch (simd_level()) {
+            case SimdLevel::AVX2:  i = _decode_quals_avx2(qual, n, offset, reverse, out); break;
+            case SimdLevel::SSSE3: i = _decode_quals_ssse3(qual, n, offset, reverse, out); break;
+            default: break;
+        }
+#endif
+        if (reverse) {
+            for (; i < n; ++i) out[n - 1 - i] = (char)(qual[i] + offset);
+        } else {
+            for (; i < n; ++i) out[i] = (char)(qual[i] + offset);
+        }
+    }
+
+    QualStats qual_stats(const uint8_t *qual, int n, int threshold) {
+
+        QualStats s;
+        s.n = n > 0 ? n : 0;
+        s.sum = 0;
+        s.min = -1;
+        s.n_below = 0;
+
+        // A quality is in [0, 255].
+        int t = threshold > 256 ? 256 : (threshold < 0 ? 0 : threshold);
+
+        int i = 0;
+#ifdef NGSLIB_X86_DISPATCH
+        switch (simd_level()) {
+            case SimdLevel::AVX2:  i = _qual_stats_avx2(qual, n, t, s); break;
+            case SimdLevel::SSSE3: i = _qual_stats_ssse3(qual, n, t, s); break;
+            default: break;
+        }
+        if (t == 0) s.n_below = 0;  // t - 1 wraps to 255 in the kernels, which counts all.
+#endif
+        for (; i < n; ++i) {
+            s.sum += qual[i];
+            if (s.min < 0 || qual[i] < s.min) s.min = qual[i];
+            if (qual[i] < t) ++s.n_below;
+        }
+
+        return s;
+    }
+
+}  // namespace ngslib
@@ -0,0 +1,28 @@
+#include <stdexcept>
+
+#include "ngslib/thread_pool.h"
+#include "ngslib/utils.h"
+
+namespace ngslib {
+
+    ThreadPool::ThreadPool(int nthreads, int qsize) {
+
+        if (nthreads <= 0) {
+            throw std::invalid_argument("[thread_pool.cpp::ThreadPool] The number of "
+                                        "threads must be > 0, but got: " + tostring(nthreads));
+        }
+
+        _tp.qsize = qsize;
+        _tp.pool = hts_tpool_init(nthreads);
+        if (!_tp.pool) {
+            throw std::invalid_argument("[thread_pool.cpp::ThreadPool] Fail to create a "
+                                        "thread pool with " + tostring(nthreads) + " threads.");
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        if (_tp.pool) hts_tpool_destroy(_tp.pool);
+        _tp.pool = NULL;
+    }
+
+}  // namespace ngslib
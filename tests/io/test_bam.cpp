@@ -1,10 +1,14 @@
 // Author: Shujia Huang
 // Date: 2021-08-25
 #include <iostream>
+#include <algorithm>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 #include <ngslib/bam.h>
 #include <ngslib/bam_record.h>
+#include <ngslib/thread_pool.h>
 
 void ret_br(ngslib::Bam &b) {
 
@@ -84,5 +88,115 @@ int main() {
     ret_br(b1);
     std::cout << "End loop status: " << good << "\n\n";
 
+    std::cout << "\n** Loop multiple regions, overlapping ones are merged **\n";
+    std::vector<std::string> regions;
+    regions.push_back("CHROMOSOME_I:914-934");
+    regions.push_back("CHROMOSOME_I:900-920");
+    regions.push_back("CHROMOSOME_IV");
+    good = b1.fetch(regions);
+    ret_br(b1);
+    std::cout << "End loop status: " << good << "\n\n";
+
+    std::cout << "\n** Loop the regions in BED file **\n";
+    good = b1.fetch_bed("../data/range.bed");
+    ret_br(b1);
+    std::cout << "End loop status: " << good << "\n\n";
+
+    std::cout << "\n** Range-for over CHROMOSOME_I:900-1000 **\n";
+    for (auto &r : b2.fetch("CHROMOSOME_I:900-1000")) {
+        std::cout << r.qname() << "\t" << r.reference_start_pos() << "\t" << r.cigar() << "\n";
+    }
+    std::cout << "End loop status: " << b2.io_status() << "\n\n";
+
+    b2.fetch("CHROMOSOME_I");
+    long n_reverse = std::count_if(b2.begin(), b2.end(),
+                                   [](const BamRecord &r) { return r.is_mapped_reverse(); });
+    std::cout << "Reverse strand reads in CHROMOSOME_I: " << n_reverse << "\n\n";
+
+    std::cout << "\n** Read ahead 16 records in background **\n";
+    Bam b7(fn2, "r");
+    b7.set_prefetch(16);
+    ret_br(b7);
+    std::cout << "End loop status: " << b7.io_status() << "\n";
+    b7.fetch("CHROMOSOME_I:900-1000");  // Records read ahead are dropped.
+    ret_br(b7);
+    std::cout << "End loop status: " << b7.io_status() << "\n\n";
+
+    std::cout << "\n** Decode positions, flags and CIGAR only **\n";
+    Bam b8(fn1, "r");
+    b8.set_fields(ngslib::Fields::POS | ngslib::Fields::RNAME | ngslib::Fields::CIGAR);
+    for (auto &r : b8.fetch("CHROMOSOME_I:900-1000")) {
+        std::cout << r << "\t" << r.reference_end_pos() << "\n";  // Undecoded fields are '*'.
+    }
+    try {
+        b8.fetch("CHROMOSOME_I:900-1000").begin()->query_sequence();
+    } catch (const std::invalid_argument &e) {
+        std::cout << "Expected error: " << e.what() << "\n\n";
+    }
+
+    std::cout << "\n** Skip duplicates, secondary and QC failed reads with MAPQ < 20 **\n";
+    Bam b9(fn2, "r");
+    b9.set_filter(ngslib::ReadFilter(0, BAM_FDUP | BAM_FSECONDARY | BAM_FQCFAIL, 20));
+    long n_pass = std::count_if(b9.begin(), b9.end(), [](const BamRecord &r) { return true; });
+    std::cout << "Records passed the filter: " << n_pass << "\n";
+
+    Bam b10(fn2, "r");
+    b10.set_filter("mapq >= 20 && !flag.dup");
+    n_pass = std::count_if(b10.begin(), b10.end(), [](const BamRecord &r) { return true; });
+    std::cout << "Records passed the filter expression: " << n_pass << "\n\n";
+
+    std::cout << "\n** Index statistics **\n";
+    ngslib::IndexStats stats = b9.index_stats();
+    std::cout << stats;
+    for (size_t i = 0; i < stats.contigs.size(); ++i) {
+        std::cout << stats.contigs[i].name << " ~" << stats.contigs[i].bytes << " bytes\n";
+    }
+    std::cout << "\n" << Bam(fn1).index_stats() << "\n";  // -1 for CRAM
+
+    // Decompress with a private pool and a pool shared by two files.
+    Bam b4(fn2, "r", 2);
+    ngslib::SharedThreadPool tp = ngslib::make_thread_pool(4);
+    Bam b5(fn1, "r", tp);
+    Bam b6(fn2, "r", tp);
+    std::cout << "\n** Loop the data with 2 threads **\n";
+    ret_br(b4);
+
+    std::cout << "\n** Loop the data with a shared pool of " << tp->size() << " threads **\n";
+    good = b5.fetch("CHROMOSOME_I");
+    ret_br(b5);
+    ret_br(b6);
+    std::cout << "Pool reference count: " << tp.use_count() << "\n\n";
+
+    // Read by batch, the slots of RecordBatch are reused between batches.
+    std::cout << "\n** Loop CHROMOSOME_I by batch **\n";
+    ngslib::RecordBatch batch(4);
+    b2.fetch("CHROMOSOME_I");
+    while (b2.read_batch(batch, 4) > 0) {
+        std::cout << "* Batch size: " << batch.size() << " ; capacity: " << batch.capacity()
+                  << " ; Read status: " << b2.io_status() << "\n";
+        for (size_t i = 0; i < batch.size(); ++i) {
+            std::cout << batch[i] << "\n";
+        }
+    }
+    std::cout << "End loop status: " << b2.io_status() << "\n\n";
+
+    // Read by columns, FLAG statistics and insert sizes of the selected reads.
+    std::cout << "\n** flagstat of CHROMOSOME_I by columnar batches **\n";
+    ngslib::ColumnBatch cols(ngslib::ColumnPayload::QUAL);
+    ngslib::Selection sel;
+    ngslib::FlagStat st;
+    std::vector<uint64_t> isize_hist;
+    size_t n_selected = 0;
+    b2.fetch("CHROMOSOME_I");
+    while (b2.read_batch(cols, 1000) > 0) {
+        cols.flag_stat(st);
+        cols.select(ngslib::ReadFilter(BAM_FPROPER_PAIR, BAM_FDUP | BAM_FSECONDARY, 20), sel);
+        cols.insert_size_hist(isize_hist, 1000, &sel);
+        n_selected += sel.count();
+    }
+    std::cout << "total: " << st.total << "; mapped: " << st.mapped << "; paired: " << st.paired
+              << "; proper_pair: " << st.proper_pair << "; singletons: " << st.singletons
+              << "; duplicates: " << st.duplicates << "; proper pairs with MAPQ >= 20: " << n_selected << "\n";
+
     return 0;
 }
\ No newline at end of file
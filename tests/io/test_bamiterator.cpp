@@ -50,5 +50,11 @@ int main() {
     read_br(bi_2);
 //    read_br(bi_1);
 
+    // Range-for, the record is reused by the whole loop.
+    BamIterator bi_4(b.fp(), b.idx(), b.header().h(), "CHROMOSOME_I:900-1000");
+    for (BamRecord &al : bi_4) {
+        std::cout << "* Range-for: " << al.qname() << "\t" << al.reference_start_pos() << "\n";
+    }
+
     return 0;
 }
\ No newline at end of file
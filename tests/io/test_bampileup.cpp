@@ -0,0 +1,47 @@
+// Author: Shujia Huang
+// Date: 2026-10-17
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <ngslib/bam_pileup.h>
+
+int main() {
+    using ngslib::BamPileup;
+    using ngslib::PileupColumn;
+
+    std::vector<std::string> fns;
+    fns.push_back("../data/range.bam");
+    fns.push_back("../data/range.cram");
+
+    std::cout << "** Pileup of " << fns.size() << " files in CHROMOSOME_I:1000-1020 **\n";
+    BamPileup plp(fns);
+    plp.set_min_baseq(0);
+    plp.fetch("CHROMOSOME_I:1000-1020");
+    while (plp.next() >= 0) {
+        std::cout << plp.header().seq_name(plp.tid()) << "\t" << plp.pos() + 1;
+        for (size_t i = 0; i < plp.size(); ++i) {
+            const PileupColumn &c = plp.column(i);
+            std::string bases(c.bases.begin(), c.bases.end());
+            std::string quals(c.size(), ' ');
+            for (size_t j = 0; j < c.size(); ++j) {
+                quals[j] = (char)(c.quals[j] + 33);
+                if (c.reverse[j] && bases[j] != '*' && bases[j] != '>') bases[j] += 'a' - 'A';
+            }
+            std::cout << "\t" << c.size() << "\t" << bases << "\t" << quals;
+        }
+        std::cout << "\n";
+    }
+
+    // Depth of one file with mpileup's default filters.
+    BamPileup plp1("../data/range.bam");
+    plp1.fetch("CHROMOSOME_II:1-500");
+    size_t n = 0, total = 0;
+    while (plp1.next() >= 0) {
+        ++n;
+        total += plp1.depth();
+    }
+    std::cout << "\n** CHROMOSOME_II:1-500, covered positions: " << n << ", total depth: " << total << "\n";
+
+    return 0;
+}
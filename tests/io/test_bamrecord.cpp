@@ -2,6 +2,9 @@
 // Date: 2021-08-25
 #include <iostream>
 #include <string>
+#include <algorithm>
+#include <vector>
+#include <utility>
 
 #include <htslib/sam.h>
 #include <ngslib/bam_header.h>
@@ -33,19 +36,42 @@ int main() {
     BamRecord br4 = al;
 
     int read_count = 0;
+    std::string seq, qual;  // Reused by all the records.
     std::cout << hdr << "\n";
     while (br3.load_read(fp, hdr.h()) >= 0) {
 
         std::cout << br3 << "; bool: " << bool(br3) << "\n";
+
+        // The original read as sequenced.
+        br3.query_sequence(seq, br3.is_mapped_reverse());
+        br3.query_qual(qual, 33, br3.is_mapped_reverse());
+        std::cout << " * SIMD level: " << ngslib::simd_level() << "; original read: "
+                  << seq << " " << qual << "\n";
+
+        // Typed tags, all of them are found by one scan of the aux data.
+        br3.index_tags();
+        int64_t nm;
+        const char *md = br3.get_string_tag("MD");
+        std::cout << " * NM: " << (br3.get_int_tag("NM", nm) ? ngslib::tostring(nm) : "NA")
+                  << "; MD: " << (md ? md : "NA") << "; type of XT: " << br3.tag_type("XT") << "\n";
         std::cout << " * Read count: " << ++read_count
 
                   << "; align_length: " << br3.align_length()
                   << "; match_length('M'): " << br3.match_length()
+                  << "; cigar_view: " << br3.cigar_view().to_string()
+                  << "; cigar ops: " << br3.cigar_view().size()
+                  << "; soft clips: " << std::count_if(br3.cigar_view().begin(), br3.cigar_view().end(),
+                                                       [](const ngslib::CigarOp &op) {
+                                                           return op.type() == BAM_CSOFT_CLIP;
+                                                       })
+                  << "; max_insertion_size: " << br3.max_insertion_size()
                   << "; Read name: " << br3.qname()
                   << "; Read length: " << br3.query_length()
                   << "; query_sequence: " << br3.query_sequence()
                   << "; query_qual: " << br3.query_qual()
                   << "; mean_qqual_phred: " << br3.mean_qqual()
+                  << "; min_qual: " << br3.qual_stats(20).min
+                  << "; qual < 20: " << br3.qual_stats(20).n_below
                   << "; query_start_pos: " << br3.query_start_pos()
                   << "; query_start_pos_reverse: " << br3.query_start_pos_reverse()
                   << "; query_end_pos: " << br3.query_end_pos()
@@ -89,6 +115,12 @@ int main() {
 
     br3.set_qc_fail();
 
+    // Move and clone.
+    std::vector<BamRecord> records;
+    records.push_back(br4.clone());      // A deep copy moved into vector
+    BamRecord br5 = std::move(records[0]);
+    std::cout << "Moved: " << bool(br5) << "; moved-from: " << bool(records[0]) << "\n";
+
     sam_close(fp);
     return 0;
 }
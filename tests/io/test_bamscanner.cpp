@@ -0,0 +1,48 @@
+// Author: Shujia Huang
+// Date: 2026-10-17
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <ngslib/bam_scanner.h>
+
+int main() {
+    using ngslib::BamScanner;
+    using ngslib::BamRecord;
+    using ngslib::GenomeRegion;
+
+    std::string fn1 = "../data/range.bam";
+    std::string fn2 = "../data/range.cram";
+
+    int nthreads = 4;
+    BamScanner bs1(fn1, nthreads, 2000);                  // 2kb per shard
+    BamScanner bs2(fn2, nthreads, 100000, true);          // include unmapped reads
+
+    for (size_t i = 0; i < bs1.shards().size(); ++i) {
+        std::cout << "Shard " << i << ": " << bs1.shards()[i].to_string(bs1.header()) << "\n";
+    }
+
+    // Keep the results of each worker separately, no lock is needed.
+    std::vector<size_t> mapped(nthreads, 0);
+    size_t n = bs1.run([&mapped](const GenomeRegion &shard, const BamRecord &br, int worker_id) {
+        if (br.is_mapped()) ++mapped[worker_id];
+    });
+
+    std::cout << "\n** Records visited in " << fn1 << ": " << n << "\n";
+    for (int i = 0; i < nthreads; ++i) {
+        std::cout << "Worker " << i << " mapped reads: " << mapped[i] << "\n";
+    }
+
+    std::vector<size_t> counts(nthreads, 0);
+    n = bs2.run([&counts](const GenomeRegion &shard, const BamRecord &br, int worker_id) {
+        ++counts[worker_id];
+    });
+    std::cout << "\n** Records visited in " << fn2 << ": " << n << "\n";
+
+    // The reads spanning two shards are visited twice without ownership.
+    bs1.set_owned_only(false);
+    n = bs1.run([](const GenomeRegion &shard, const BamRecord &br, int worker_id) {});
+    std::cout << "\n** Records visited in " << fn1 << " without ownership: " << n << "\n";
+
+    return 0;
+}
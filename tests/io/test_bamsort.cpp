@@ -0,0 +1,57 @@
+// Author: Shujia Huang
+// Date: 2026-10-17
+#include <iostream>
+#include <string>
+
+#include <ngslib/bam.h>
+#include <ngslib/bam_sort.h>
+
+int main() {
+    using ngslib::Bam;
+    using ngslib::BamRecord;
+    using ngslib::BamSorter;
+    using ngslib::SortOrder;
+
+    std::cout << "** Sort ../data/range.bam by queryname with 1Mb memory and 2 threads **\n";
+    BamSorter by_name("../data/range.bam", SortOrder::QUERYNAME);
+    by_name.set_max_memory(1 << 20);
+    by_name.set_threads(2);
+    size_t n = by_name.run("range.name.bam");
+    std::cout << "records: " << n << ", temporary runs: " << by_name.n_runs() << "\n";
+
+    Bam name_bam("range.name.bam", "r");
+    BamRecord pre, cur;
+    size_t n_read = 0, n_bad = 0;
+    while (name_bam.next(cur) >= 0) {
+        if (n_read++ > 0 && ngslib::queryname_less(cur.b(), pre.b())) ++n_bad;
+        pre = cur;
+    }
+    std::cout << "read back: " << n_read << ", out of order: " << n_bad << "\n";
+
+    std::cout << "\n** Sort range.name.bam back by coordinate and index it **\n";
+    BamSorter by_coord("range.name.bam");
+    by_coord.set_max_memory(1 << 20);
+    by_coord.set_threads(2);
+    by_coord.set_index(true);
+    n = by_coord.run("range.sorted.bam");
+    std::cout << "records: " << n << ", temporary runs: " << by_coord.n_runs() << "\n";
+
+    Bam coord_bam("range.sorted.bam", "r");
+    n_read = n_bad = 0;
+    while (coord_bam.next(cur) >= 0) {
+        if (n_read++ > 0 && ngslib::coordinate_less(cur.b(), pre.b())) ++n_bad;
+        pre = cur;
+    }
+    std::cout << "read back: " << n_read << ", out of order: " << n_bad << "\n";
+
+    coord_bam.index_load();
+    bool good = coord_bam.fetch("CHROMOSOME_I");
+    n_read = 0;
+    while (good && coord_bam.next(cur) >= 0) ++n_read;
+    std::cout << "Fetch CHROMOSOME_I by the new index: " << n_read << " records\n";
+
+    std::cout << "\n** Sort in memory by the function **\n";
+    std::cout << ngslib::sort("../data/range.bam", "range.sorted2.bam") << " records\n";
+
+    return 0;
+}
@@ -0,0 +1,54 @@
+// Author: Shujia Huang
+// Date: 2026-10-17
+#include <iostream>
+#include <string>
+
+#include <ngslib/bam.h>
+#include <ngslib/bam_record.h>
+#include <ngslib/bam_writer.h>
+
+int main() {
+    using ngslib::Bam;
+    using ngslib::BamRecord;
+    using ngslib::BamWriter;
+
+    std::string fn1 = "../data/range.bam";
+    std::string out1 = "../data/test_output.bam";
+    std::string out2 = "../data/test_output.sam";
+
+    Bam b1(fn1, "r");
+    BamWriter w1(out1, b1.header(), "wb", 4);   // BAM compressed by 4 threads
+    w1.set_index();                             // and indexed on the fly
+    BamWriter w2(out2, b1.header(), "w");       // SAM
+    w2.set_buffer(8, 2);
+
+    BamRecord al;
+    int n = 0;
+    while (b1.read(al) >= 0) {
+        if (w1.write(al) < 0 || w2.write(al) < 0) {
+            std::cerr << "Fail to write record: " << al << "\n";
+            return 1;
+        }
+        ++n;
+    }
+
+    std::cout << "Close " << w1 << " status: " << w1.close() << "\n";
+    std::cout << "Close " << w2 << " status: " << w2.close() << "\n";
+
+    // Read back
+    Bam b2(out1, "r");
+    int m = 0;
+    while (b2.read(al) >= 0) ++m;
+    std::cout << "Records written: " << n << " ; read back: " << m << "\n";
+
+    // The index written along with the file.
+    bool good = b2.fetch("CHROMOSOME_I");
+    m = 0;
+    while (good && b2.read(al) >= 0) ++m;
+    std::cout << "Fetch CHROMOSOME_I by the index written on the fly: " << m << "\n";
+
+    // Rebuild it by 2 threads.
+    std::cout << "Rebuild the index of " << out1 << " status: " << b2.index_build(0, 2) << "\n";
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+// Author: Shujia Huang
+// Date: 2026-10-17
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+
+#include <ngslib/coverage.h>
+
+int main() {
+    using ngslib::CoverageCounter;
+    using ngslib::CoverageSummary;
+
+    // Per-base depth of CHROMOSOME_I:1000-1020, include the zero ones.
+    std::cout << "** Depth of CHROMOSOME_I:1000-1020 **\n";
+    CoverageCounter cc("../data/range.bam");
+    std::vector<ngslib::GenomeRegion> regions = ngslib::parse_regions(
+            cc.header(), std::vector<std::string>(1, "CHROMOSOME_I:1000-1020"));
+    cc.run(regions, [&cc](int tid, hts_pos_t beg, const uint32_t *depth, size_t n, int /*worker_id*/) {
+        for (size_t i = 0; i < n; ++i) {
+            std::cout << cc.header().seq_name(tid) << "\t" << beg + i + 1 << "\t" << depth[i] << "\n";
+        }
+    });
+
+    // Total depth of the whole genome by 2 threads, with a small window to
+    // make it slide.
+    CoverageCounter cc2("../data/range.cram", 2);
+    cc2.set_window(100);
+    std::mutex mtx;
+    uint64_t total = 0, covered = 0;
+    cc2.run([&](int /*tid*/, hts_pos_t /*beg*/, const uint32_t *depth, size_t n, int /*worker_id*/) {
+        uint64_t t = 0, c = 0;
+        for (size_t i = 0; i < n; ++i) {
+            t += depth[i];
+            if (depth[i]) ++c;
+        }
+        std::lock_guard<std::mutex> lock(mtx);
+        total += t;
+        covered += c;
+    });
+    std::cout << "\n** range.cram, covered positions: " << covered << ", total depth: " << total << "\n";
+
+    // Summary of 1kb bins and BED targets.
+    std::cout << "\n** 1kb bins of CHROMOSOME_II (mean, median, fraction >= 5x) **\n";
+    cc.set_min_depth(5);
+    std::vector<CoverageSummary> bins = cc.bins(1000);
+    for (size_t i = 0; i < bins.size(); ++i) {
+        if (cc.header().seq_name(bins[i].tid) != "CHROMOSOME_II") continue;
+        std::cout << cc.header().seq_name(bins[i].tid) << "\t" << bins[i].beg << "\t" << bins[i].end << "\t"
+                  << bins[i].mean << "\t" << bins[i].median << "\t" << bins[i].frac_min_depth << "\n";
+    }
+
+    std::cout << "\n** Targets in ../data/range.bed **\n";
+    std::vector<CoverageSummary> targets = cc.targets("../data/range.bed");
+    for (size_t i = 0; i < targets.size(); ++i) {
+        std::cout << cc.header().seq_name(targets[i].tid) << "\t" << targets[i].beg << "\t" << targets[i].end << "\t"
+                  << targets[i].mean << "\t" << targets[i].median << "\t" << targets[i].frac_min_depth << "\n";
+    }
+
+    return 0;
+}
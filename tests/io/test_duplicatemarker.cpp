@@ -0,0 +1,46 @@
+// Author: Shujia Huang
+// Date: 2026-10-17
+#include <iostream>
+#include <string>
+
+#include <ngslib/bam.h>
+#include <ngslib/duplicate_marker.h>
+
+int main() {
+    using ngslib::Bam;
+    using ngslib::BamRecord;
+    using ngslib::DuplicateMarker;
+    using ngslib::DuplicateStats;
+
+    std::cout << "** Mark duplicates of ../data/range.bam by 2 threads **\n";
+    DuplicateMarker dm("../data/range.bam", 2);
+    dm.set_optical_distance(100);
+    DuplicateStats stats = dm.run("range.markdup.bam");
+    std::cout << stats;
+
+    // All the records are in the output, in the same order.
+    Bam in("../data/range.bam", "r"), out("range.markdup.bam", "r");
+    BamRecord a, b;
+    size_t n = 0, n_dup = 0, n_diff = 0;
+    while (in.next(a) >= 0 && out.next(b) >= 0) {
+        ++n;
+        if (b.is_duplicate()) ++n_dup;
+        if (a.qname() != b.qname() || a.reference_start_pos() != b.reference_start_pos()) ++n_diff;
+    }
+    std::cout << "records: " << n << ", marked: " << n_dup << ", out of order: " << n_diff << "\n";
+
+    std::cout << "\n** Remove the duplicates and index the output **\n";
+    DuplicateMarker rm("../data/range.bam");
+    rm.set_remove(true);
+    rm.set_index(true);
+    std::cout << rm.run("range.rmdup.bam");
+
+    Bam rmdup("range.rmdup.bam", "r");
+    rmdup.index_load();
+    bool good = rmdup.fetch("CHROMOSOME_I");
+    n = 0;
+    while (good && rmdup.next(b) >= 0) ++n;
+    std::cout << "Fetch CHROMOSOME_I by the new index: " << n << " records\n";
+
+    return 0;
+}
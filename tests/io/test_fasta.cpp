@@ -1,5 +1,6 @@
 #include <iostream>
 #include <string>
+#include <utility>
 
 #include <ngslib/fasta.h>
 
@@ -38,6 +39,9 @@ int main() {
     std::cout << "fa.has_seq(\"ref2\"): " << fa.has_seq("ref2") << std::endl;
     std::cout << "fa.has_seq(\"ref5\"): " << fa.has_seq("ref5") << std::endl;
     std::cout << "fa[\"ref2\"]: " << fa["ref2"] << std::endl;
+
+    Fasta fa6 = std::move(fa1);  // Take over the index, no reloading.
+    std::cout << "fa6.fetch(\"ref1\", 0, 10) after move: " << fa6.fetch("ref1", 0, 10) << std::endl;
 //    std::cout << "The sequence: " << fa.fetch("ref1", 12, 10) << std::endl;
 
     return 0;
@@ -0,0 +1,42 @@
+// Author: Shujia Huang
+// Date: 2026-10-17
+#include <iostream>
+#include <string>
+
+#include <ngslib/bam.h>
+#include <ngslib/bam_iterator.h>
+#include <ngslib/index_cache.h>
+
+int main() {
+    using ngslib::Bam;
+    using ngslib::BamRecord;
+    using ngslib::BamIterator;
+    using ngslib::IndexCache;
+
+    std::string fn1 = "../data/range.bam";
+    std::string fn2 = "../data/range.cram";
+    IndexCache &cache = IndexCache::instance();
+
+    // Three handles of one BAM file share the same index.
+    Bam b1(fn1, "r"), b2(fn1, "r"), b3(fn1, "r");
+    std::cout << "b1.idx() == b2.idx(): " << (b1.idx() == b2.idx()) << "\n";
+    std::cout << "b2.idx() == b3.idx(): " << (b2.idx() == b3.idx()) << "\n";
+    std::cout << "Cached: " << cache.size() << " ; bytes: " << cache.bytes()
+              << " ; hit: " << cache.hit() << " ; miss: " << cache.miss() << "\n";
+
+    // CRAM index is bound to the file handle, never cached.
+    Bam b4(fn2, "r");
+    std::cout << "CRAM shared index is NULL: " << !b4.shared_idx() << "\n";
+
+    // The iterator keeps the index alive even after the cache drops it.
+    BamIterator it(b1.fp(), b1.shared_idx(), b1.header().h(), "CHROMOSOME_I:900-1000");
+    cache.clear();
+    cache.set_budget(0);
+
+    BamRecord al;
+    int n = 0;
+    while (it.next(al) >= 0) ++n;
+    std::cout << "Records in CHROMOSOME_I:900-1000: " << n << " ; cached: " << cache.size() << "\n";
+
+    return 0;
+}
@@ -0,0 +1,46 @@
+// Author: Shujia Huang
+// Date: 2026-10-17
+#include <iostream>
+#include <string>
+
+#include <ngslib/bam.h>
+#include <ngslib/mate_pairer.h>
+
+int main() {
+    using ngslib::Bam;
+    using ngslib::BamRecord;
+    using ngslib::MatePairer;
+
+    std::cout << "** Mate pairs of ../data/range.bam **\n";
+    Bam bam("../data/range.bam", "r");
+    MatePairer mp;
+    BamRecord r1, r2;
+    size_t n = 0;
+    while (mp.next(bam, r1, r2) >= 0) {
+        if (n++ < 5) {
+            std::cout << r1.qname() << "\t" << r1.tid_name(bam.header()) << ":" << r1.reference_start_pos() + 1
+                      << "\t" << r2.tid_name(bam.header()) << ":" << r2.reference_start_pos() + 1
+                      << "\t" << r1.insert_size() << "\n";
+        }
+    }
+    std::cout << "pairs: " << mp.n_pairs() << ", orphans: " << mp.n_orphans() << ", spilled: "
+              << mp.n_spilled() << ", skipped: " << mp.n_skipped() << "\n";
+
+    // A tiny table and window spill nearly everything, the pairs are the same.
+    std::cout << "\n** The same with at most 10 records in memory **\n";
+    Bam bam2("../data/range.bam", "r");
+    MatePairer mp2(10, 100);
+    mp2.set_partitions(4);
+    while (mp2.next(bam2, r1, r2) >= 0) {}
+    std::cout << "pairs: " << mp2.n_pairs() << ", orphans: " << mp2.n_orphans() << ", spilled: "
+              << mp2.n_spilled() << ", skipped: " << mp2.n_skipped() << "\n";
+
+    // Mates out of the region are orphans.
+    std::cout << "\n** Mate pairs in CHROMOSOME_I:1000-2000 **\n";
+    mp.reset();
+    bam.fetch("CHROMOSOME_I:1000-2000");
+    while (mp.next(bam, r1, r2) >= 0) {}
+    std::cout << "pairs: " << mp.n_pairs() << ", orphans: " << mp.n_orphans() << "\n";
+
+    return 0;
+}
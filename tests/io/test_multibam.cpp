@@ -0,0 +1,53 @@
+// Author: Shujia Huang
+// Date: 2026-10-17
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <ngslib/multi_bam.h>
+
+int main() {
+    using ngslib::MultiBam;
+    using ngslib::BamRecord;
+
+    std::vector<std::string> fns;
+    fns.push_back("../data/range.bam");
+    fns.push_back("../data/range.cram");
+    fns.push_back("../data/range.bam");
+
+    // Keep at most 2 files open and read 16 records ahead for each file.
+    MultiBam mb(fns, 2, 16);
+    std::cout << "Merge " << mb.size() << " files with "
+              << mb.header().h()->n_targets << " reference sequences.\n";
+
+    BamRecord br;
+    std::vector<size_t> counts(mb.size(), 0);
+    int32_t last_tid = 0;
+    hts_pos_t last_pos = 0;
+    size_t n = 0, unsorted = 0;
+    while (mb.read(br) >= 0) {
+        ++counts[mb.source()];
+        ++n;
+
+        uint32_t tid = br.b()->core.tid;
+        if (tid < (uint32_t)last_tid || (tid == (uint32_t)last_tid && br.b()->core.pos < last_pos)) ++unsorted;
+        last_tid = br.b()->core.tid;
+        last_pos = br.b()->core.pos;
+
+        if (n <= 5) std::cout << mb.source() << "\t" << br << "\n";
+    }
+    std::cout << "\n** Merged " << n << " records, " << unsorted << " out of order, "
+              << mb.n_open() << " files still open.\n";
+    for (size_t i = 0; i < mb.size(); ++i) {
+        std::cout << mb.fname(i) << ": " << counts[i] << "\n";
+    }
+
+    // Merge one region only.
+    n = 0;
+    for (auto &r: mb.fetch("CHROMOSOME_I:1000-2000")) {
+        if (n++ < 3) std::cout << mb.source() << "\t" << r.qname() << "\t" << r.reference_start_pos() << "\n";
+    }
+    std::cout << "\n** Merged " << n << " records in CHROMOSOME_I:1000-2000\n";
+
+    return 0;
+}
@@ -0,0 +1,41 @@
+// Author: Shujia Huang
+// Date: 2026-10-17
+#include <iostream>
+#include <string>
+
+#include <ngslib/bam.h>
+#include <ngslib/record_arena.h>
+
+int main() {
+    using ngslib::Bam;
+    using ngslib::BamRecord;
+    using ngslib::RecordArena;
+
+    std::cout << "** Pack all the records of ../data/range.bam into 64Kb slabs **\n";
+    RecordArena arena(64 << 10);
+    Bam bf("../data/range.bam", "r");
+    BamRecord al;
+    size_t n_heap = 0;  // What bam_dup1() would take for the same records.
+    while (bf.next(al) >= 0) {
+        arena.add(al);
+        n_heap += sizeof(bam1_t) + al.b()->m_data;
+    }
+    std::cout << "records: " << arena.size() << "; slabs: " << arena.n_slabs()
+              << "; bytes_used: " << arena.bytes_used() << "; bytes_allocated: "
+              << arena.bytes_allocated() << "; by bam_dup1(): >= " << n_heap << "\n";
+
+    for (size_t i = 0; i < arena.size() && i < 5; ++i) {
+        BamRecord r = arena.record(i);  // A handle, nothing is copied.
+        std::cout << r << "; cigar: " << r.cigar_view().to_string() << "\n";
+    }
+
+    BamRecord copy = arena.record(0).clone();  // An ordinary record, outlives clear().
+    arena.clear();
+    std::cout << "After clear(), records: " << arena.size() << "; slabs kept: " << arena.n_slabs()
+              << "; the copy: " << copy.qname() << "\n";
+
+    arena.release();
+    std::cout << "After release(), bytes_allocated: " << arena.bytes_allocated() << "\n";
+
+    return 0;
+}